@@ -0,0 +1,460 @@
+#include "uka-animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UKA_ANIMATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace uka
+{
+    namespace animation
+    {
+        // Channels are evaluated in groups of this many SIMD lanes
+        constexpr uint32_t lane_count = 4;
+
+        struct alignas(16) Lanes
+        {
+            float v[4][lane_count];
+        };
+
+        // out = a + (b - a) * u per lane
+        static auto lerp_lanes(const Lanes& a, const Lanes& b, const float* u, uint32_t components, Lanes& out) -> void
+        {
+#if UKA_ANIMATION_SSE
+            auto t = _mm_load_ps(u);
+            for(auto c = uint32_t{0}; c < components; c++)
+            {
+                auto va = _mm_load_ps(a.v[c]);
+                auto vb = _mm_load_ps(b.v[c]);
+                _mm_store_ps(out.v[c], _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), t)));
+            }
+#else
+            for(auto c = uint32_t{0}; c < components; c++)
+            {
+                for(auto l = uint32_t{0}; l < lane_count; l++)
+                {
+                    out.v[c][l] = a.v[c][l] + (b.v[c][l] - a.v[c][l]) * u[l];
+                }
+            }
+#endif
+        }
+
+        // Normalized lerp along the shorter arc, b is flipped into a's hemisphere first
+        static auto nlerp_lanes(const Lanes& a, Lanes b, const float* u, Lanes& out) -> void
+        {
+#if UKA_ANIMATION_SSE
+            auto dot = _mm_setzero_ps();
+            for(auto c = 0; c < 4; c++)
+            {
+                dot = _mm_add_ps(dot, _mm_mul_ps(_mm_load_ps(a.v[c]), _mm_load_ps(b.v[c])));
+            }
+            auto sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+            auto t = _mm_load_ps(u);
+            auto length = _mm_setzero_ps();
+            __m128 result[4];
+            for(auto c = 0; c < 4; c++)
+            {
+                auto va = _mm_load_ps(a.v[c]);
+                auto vb = _mm_xor_ps(_mm_load_ps(b.v[c]), sign);
+                result[c] = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), t));
+                length = _mm_add_ps(length, _mm_mul_ps(result[c], result[c]));
+            }
+            auto inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(length, _mm_set1_ps(1e-30f))));
+            for(auto c = 0; c < 4; c++)
+            {
+                _mm_store_ps(out.v[c], _mm_mul_ps(result[c], inverse_length));
+            }
+#else
+            for(auto l = uint32_t{0}; l < lane_count; l++)
+            {
+                auto dot = a.v[0][l] * b.v[0][l] + a.v[1][l] * b.v[1][l] + a.v[2][l] * b.v[2][l] + a.v[3][l] * b.v[3][l];
+                auto sign = dot < 0.0f ? -1.0f : 1.0f;
+                auto length = 0.0f;
+                for(auto c = 0; c < 4; c++)
+                {
+                    out.v[c][l] = a.v[c][l] + (b.v[c][l] * sign - a.v[c][l]) * u[l];
+                    length += out.v[c][l] * out.v[c][l];
+                }
+                auto inverse_length = 1.0f / std::sqrt(std::max(length, 1e-30f));
+                for(auto c = 0; c < 4; c++)
+                {
+                    out.v[c][l] *= inverse_length;
+                }
+            }
+#endif
+        }
+
+        // Evaluates channels [first, first + lanes) of a stream, out.v[component][lane]
+        static auto sample_lanes(const Stream& stream, uint32_t first, uint32_t lanes, float time, uint32_t* cursors, Lanes& out) -> void
+        {
+            auto a = Lanes{};
+            auto b = Lanes{};
+            alignas(16) float u[lane_count] = {};
+            for(auto l = uint32_t{0}; l < lanes; l++)
+            {
+                auto channel = first + l;
+                auto key_first = stream.first_key[channel];
+                auto key_count = stream.key_count[channel];
+                const auto* times = stream.times.data() + key_first;
+                auto k0 = find_key(times, key_count, time, cursors[channel]);
+                auto k1 = std::min(k0 + 1, key_count - 1);
+                auto duration = times[k1] - times[k0];
+                if(stream.interpolation[channel] == Interpolation::linear && duration > 0.0f)
+                {
+                    u[l] = std::min(std::max((time - times[k0]) / duration, 0.0f), 1.0f);
+                }
+                // Step keys hold their value until the next key is reached
+                if(stream.interpolation[channel] == Interpolation::step && time >= times[k1])
+                {
+                    k0 = k1;
+                }
+                for(auto c = uint32_t{0}; c < stream.components; c++)
+                {
+                    a.v[c][l] = stream.values[c][key_first + k0];
+                    b.v[c][l] = stream.values[c][key_first + k1];
+                }
+            }
+            // Unused lanes repeat the identity so the rotation path never normalizes a zero vector
+            for(auto l = lanes; l < lane_count; l++)
+            {
+                for(auto c = uint32_t{0}; c < stream.components; c++)
+                {
+                    a.v[c][l] = b.v[c][l] = c == 3 ? 1.0f : 0.0f;
+                }
+            }
+            if(stream.components == 4)
+            {
+                nlerp_lanes(a, b, u, out);
+            }
+            else
+            {
+                lerp_lanes(a, b, u, stream.components, out);
+            }
+        }
+
+        // Calls visit(channel, lanes) for every channel of every stream with the evaluated values
+        template<typename Visit>
+        static auto sample_stream(const Stream& stream, float time, std::vector<uint32_t>& cursors, Visit&& visit) -> void
+        {
+            auto values = Lanes{};
+            for(auto first = uint32_t{0}; first < stream.channel_count(); first += lane_count)
+            {
+                auto lanes = std::min(lane_count, stream.channel_count() - first);
+                sample_lanes(stream, first, lanes, time, cursors.data(), values);
+                for(auto l = uint32_t{0}; l < lanes; l++)
+                {
+                    visit(first + l, values, l);
+                }
+            }
+        }
+
+        auto Stream::add_channel(uint32_t target,
+            Interpolation mode,
+            const float* key_times,
+            const float* key_values,
+            size_t value_stride,
+            uint32_t count) -> void
+        {
+            targets.push_back(target);
+            first_key.push_back(static_cast<uint32_t>(times.size()));
+            key_count.push_back(count);
+            interpolation.push_back(mode);
+            times.insert(times.end(), key_times, key_times + count);
+            for(auto c = uint32_t{0}; c < components; c++)
+            {
+                for(auto k = uint32_t{0}; k < count; k++)
+                {
+                    values[c].push_back(key_values[k * value_stride + c]);
+                }
+            }
+        }
+
+        ClipCursor::ClipCursor(const Clip& clip)
+            : translation(clip.translation.channel_count(), 0),
+              rotation(clip.rotation.channel_count(), 0),
+              scale(clip.scale.channel_count(), 0)
+        {
+        }
+
+        auto Pose::resize(size_t count) -> void
+        {
+            for(auto& component : translation)
+            {
+                component.resize(count, 0.0f);
+            }
+            for(auto c = 0; c < 4; c++)
+            {
+                rotation[c].resize(count, c == 3 ? 1.0f : 0.0f);
+            }
+            for(auto& component : scale)
+            {
+                component.resize(count, 1.0f);
+            }
+        }
+
+        auto find_key(const float* times, uint32_t count, float time, uint32_t& cursor) -> uint32_t
+        {
+            if(count < 2 || time <= times[0])
+            {
+                return cursor = 0;
+            }
+            const auto last_key = count - 2;
+            if(time >= times[count - 1])
+            {
+                return cursor = last_key;
+            }
+            if(cursor <= last_key && times[cursor] <= time)
+            {
+                // Monotonic playback only ever walks a few keys per frame
+                for(auto step = 0; step < 4 && time > times[cursor + 1]; step++)
+                {
+                    cursor++;
+                }
+                if(time <= times[cursor + 1])
+                {
+                    return cursor;
+                }
+            }
+            // Seeks and large steps fall back to a binary search
+            auto key = std::upper_bound(times, times + count, time) - times - 1;
+            cursor = std::min(static_cast<uint32_t>(std::max<ptrdiff_t>(key, 0)), last_key);
+            return cursor;
+        }
+
+        auto sample(const Clip& clip, float time, ClipCursor& cursor, Pose& pose) -> void
+        {
+            sample_stream(clip.translation, time, cursor.translation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                for(auto c = 0; c < 3; c++)
+                {
+                    pose.translation[c][clip.translation.targets[channel]] = values.v[c][lane];
+                }
+            });
+            sample_stream(clip.rotation, time, cursor.rotation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                for(auto c = 0; c < 4; c++)
+                {
+                    pose.rotation[c][clip.rotation.targets[channel]] = values.v[c][lane];
+                }
+            });
+            sample_stream(clip.scale, time, cursor.scale, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                for(auto c = 0; c < 3; c++)
+                {
+                    pose.scale[c][clip.scale.targets[channel]] = values.v[c][lane];
+                }
+            });
+        }
+
+        // out = (accumulated + rest * missing) / (weight + missing) with missing = max(0, 1 - weight), over all targets
+        static auto resolve(float* accumulated, const float* rest, const float* weights, size_t count) -> void
+        {
+            auto i = size_t{0};
+#if UKA_ANIMATION_SSE
+            auto one = _mm_set1_ps(1.0f);
+            auto zero = _mm_setzero_ps();
+            for(; i + 4 <= count; i += 4)
+            {
+                auto weight = _mm_loadu_ps(weights + i);
+                auto missing = _mm_max_ps(_mm_sub_ps(one, weight), zero);
+                auto value = _mm_add_ps(_mm_loadu_ps(accumulated + i), _mm_mul_ps(_mm_loadu_ps(rest + i), missing));
+                _mm_storeu_ps(accumulated + i, _mm_div_ps(value, _mm_add_ps(weight, missing)));
+            }
+#endif
+            for(; i < count; i++)
+            {
+                auto missing = std::max(1.0f - weights[i], 0.0f);
+                accumulated[i] = (accumulated[i] + rest[i] * missing) / (weights[i] + missing);
+            }
+        }
+
+        static auto normalize_rotations(Pose& pose) -> void
+        {
+            auto* x = pose.rotation[0].data();
+            auto* y = pose.rotation[1].data();
+            auto* z = pose.rotation[2].data();
+            auto* w = pose.rotation[3].data();
+            auto count = pose.size();
+            auto i = size_t{0};
+#if UKA_ANIMATION_SSE
+            for(; i + 4 <= count; i += 4)
+            {
+                auto vx = _mm_loadu_ps(x + i);
+                auto vy = _mm_loadu_ps(y + i);
+                auto vz = _mm_loadu_ps(z + i);
+                auto vw = _mm_loadu_ps(w + i);
+                auto length = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_add_ps(_mm_mul_ps(vz, vz), _mm_mul_ps(vw, vw)));
+                auto inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(length, _mm_set1_ps(1e-30f))));
+                _mm_storeu_ps(x + i, _mm_mul_ps(vx, inverse_length));
+                _mm_storeu_ps(y + i, _mm_mul_ps(vy, inverse_length));
+                _mm_storeu_ps(z + i, _mm_mul_ps(vz, inverse_length));
+                _mm_storeu_ps(w + i, _mm_mul_ps(vw, inverse_length));
+            }
+#endif
+            for(; i < count; i++)
+            {
+                auto inverse_length = 1.0f / std::sqrt(std::max(x[i] * x[i] + y[i] * y[i] + z[i] * z[i] + w[i] * w[i], 1e-30f));
+                x[i] *= inverse_length;
+                y[i] *= inverse_length;
+                z[i] *= inverse_length;
+                w[i] *= inverse_length;
+            }
+        }
+
+        // Hamilton product a * b of xyzw quaternions
+        static auto multiply(const float* a, const float* b, float* out) -> void
+        {
+            out[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+            out[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+            out[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+            out[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+        }
+
+        static auto apply_additive(const Layer& layer, Pose& pose) -> void
+        {
+            const auto& clip = *layer.clip;
+            const auto weight = layer.weight;
+            sample_stream(clip.translation, layer.time, layer.cursor->translation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                auto target = clip.translation.targets[channel];
+                auto reference = clip.translation.first_key[channel];
+                for(auto c = 0; c < 3; c++)
+                {
+                    pose.translation[c][target] += (values.v[c][lane] - clip.translation.values[c][reference]) * weight;
+                }
+            });
+            sample_stream(clip.rotation, layer.time, layer.cursor->rotation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                auto target = clip.rotation.targets[channel];
+                auto reference = clip.rotation.first_key[channel];
+                // delta = sample * conjugate(reference), scaled by nlerp from identity
+                float sampled[4] = {values.v[0][lane], values.v[1][lane], values.v[2][lane], values.v[3][lane]};
+                float conjugate[4] = {-clip.rotation.values[0][reference], -clip.rotation.values[1][reference], -clip.rotation.values[2][reference], clip.rotation.values[3][reference]};
+                float delta[4];
+                multiply(sampled, conjugate, delta);
+                if(delta[3] < 0.0f)
+                {
+                    for(auto& d : delta)
+                    {
+                        d = -d;
+                    }
+                }
+                for(auto c = 0; c < 4; c++)
+                {
+                    delta[c] = (c == 3 ? 1.0f - weight : 0.0f) + delta[c] * weight;
+                }
+                float current[4] = {pose.rotation[0][target], pose.rotation[1][target], pose.rotation[2][target], pose.rotation[3][target]};
+                float result[4];
+                multiply(delta, current, result);
+                for(auto c = 0; c < 4; c++)
+                {
+                    pose.rotation[c][target] = result[c];
+                }
+            });
+            sample_stream(clip.scale, layer.time, layer.cursor->scale, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+            {
+                auto target = clip.scale.targets[channel];
+                auto reference = clip.scale.first_key[channel];
+                for(auto c = 0; c < 3; c++)
+                {
+                    auto base = clip.scale.values[c][reference];
+                    auto ratio = base != 0.0f ? values.v[c][lane] / base : 1.0f;
+                    pose.scale[c][target] *= 1.0f + (ratio - 1.0f) * weight;
+                }
+            });
+        }
+
+        auto blend(const Pose& rest, const Layer* layers, size_t layer_count, Pose& pose) -> void
+        {
+            const auto count = rest.size();
+            pose.resize(count);
+            for(auto c = 0; c < 3; c++)
+            {
+                std::fill(pose.translation[c].begin(), pose.translation[c].end(), 0.0f);
+                std::fill(pose.scale[c].begin(), pose.scale[c].end(), 0.0f);
+            }
+            for(auto& component : pose.rotation)
+            {
+                std::fill(component.begin(), component.end(), 0.0f);
+            }
+            // Total layer weight per target for translation, rotation and scale
+            auto weights = std::vector<float>(count * 3, 0.0f);
+            auto* translation_weight = weights.data();
+            auto* rotation_weight = weights.data() + count;
+            auto* scale_weight = weights.data() + count * 2;
+
+            for(auto i = size_t{0}; i < layer_count; i++)
+            {
+                const auto& layer = layers[i];
+                if(layer.additive || layer.weight <= 0.0f)
+                {
+                    continue;
+                }
+                const auto& clip = *layer.clip;
+                const auto weight = layer.weight;
+                sample_stream(clip.translation, layer.time, layer.cursor->translation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+                {
+                    auto target = clip.translation.targets[channel];
+                    for(auto c = 0; c < 3; c++)
+                    {
+                        pose.translation[c][target] += values.v[c][lane] * weight;
+                    }
+                    translation_weight[target] += weight;
+                });
+                sample_stream(clip.rotation, layer.time, layer.cursor->rotation, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+                {
+                    auto target = clip.rotation.targets[channel];
+                    // Keep every contribution in the rest rotation's hemisphere so they do not cancel out
+                    auto dot = 0.0f;
+                    for(auto c = 0; c < 4; c++)
+                    {
+                        dot += values.v[c][lane] * rest.rotation[c][target];
+                    }
+                    auto signed_weight = dot < 0.0f ? -weight : weight;
+                    for(auto c = 0; c < 4; c++)
+                    {
+                        pose.rotation[c][target] += values.v[c][lane] * signed_weight;
+                    }
+                    rotation_weight[target] += weight;
+                });
+                sample_stream(clip.scale, layer.time, layer.cursor->scale, [&](uint32_t channel, const Lanes& values, uint32_t lane)
+                {
+                    auto target = clip.scale.targets[channel];
+                    for(auto c = 0; c < 3; c++)
+                    {
+                        pose.scale[c][target] += values.v[c][lane] * weight;
+                    }
+                    scale_weight[target] += weight;
+                });
+            }
+
+            for(auto c = 0; c < 3; c++)
+            {
+                resolve(pose.translation[c].data(), rest.translation[c].data(), translation_weight, count);
+                resolve(pose.scale[c].data(), rest.scale[c].data(), scale_weight, count);
+            }
+            for(auto c = 0; c < 4; c++)
+            {
+                resolve(pose.rotation[c].data(), rest.rotation[c].data(), rotation_weight, count);
+            }
+            normalize_rotations(pose);
+
+            auto additive = false;
+            for(auto i = size_t{0}; i < layer_count; i++)
+            {
+                if(layers[i].additive && layers[i].weight > 0.0f)
+                {
+                    apply_additive(layers[i], pose);
+                    additive = true;
+                }
+            }
+            if(additive)
+            {
+                normalize_rotations(pose);
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace uka
+{
+    namespace animation
+    {
+        enum class Interpolation : uint8_t
+        {
+            linear,
+            step
+        };
+
+        // Keys of every channel animating one property of a clip, stored back to back as structure of arrays.
+        // Channels are addressed by their index, keys of channel c live in [first_key[c], first_key[c] + key_count[c]).
+        struct Stream
+        {
+            uint32_t components;
+            std::vector<uint32_t> targets;
+            std::vector<uint32_t> first_key;
+            std::vector<uint32_t> key_count;
+            std::vector<Interpolation> interpolation;
+            std::vector<float> times;
+            std::vector<float> values[4];
+
+            explicit Stream(uint32_t component_count = 0) : components(component_count) {}
+            auto channel_count() const -> uint32_t { return static_cast<uint32_t>(targets.size()); }
+            // values holds key_count elements of value_stride floats, the first `components` of each are used
+            auto add_channel(uint32_t target, Interpolation mode, const float* key_times, const float* key_values, size_t value_stride, uint32_t count) -> void;
+        };
+
+        // Translation and scale are xyz, rotation is a xyzw quaternion. Targets are indices into a Pose.
+        struct Clip
+        {
+            std::string name;
+            float start = 0.0f;
+            float end = 0.0f;
+            Stream translation{3};
+            Stream rotation{4};
+            Stream scale{3};
+        };
+
+        // Per-instance playback state, so one clip can play on many models at different times
+        struct ClipCursor
+        {
+            std::vector<uint32_t> translation;
+            std::vector<uint32_t> rotation;
+            std::vector<uint32_t> scale;
+
+            ClipCursor() = default;
+            explicit ClipCursor(const Clip& clip);
+        };
+
+        // Local transforms of all targets as structure of arrays
+        struct Pose
+        {
+            std::vector<float> translation[3];
+            std::vector<float> rotation[4];
+            std::vector<float> scale[3];
+
+            auto size() const -> size_t { return translation[0].size(); }
+            auto resize(size_t count) -> void;
+        };
+
+        struct Layer
+        {
+            const Clip* clip = nullptr;
+            ClipCursor* cursor = nullptr;
+            float time = 0.0f;
+            float weight = 1.0f;
+            // Additive layers apply their difference to the clip's first key on top of the blended result
+            bool additive = false;
+        };
+
+        // Returns key such that times[key] <= time <= times[key + 1], clamped to the first/last pair.
+        // Walks forward from cursor for monotonic playback, binary searches otherwise, and updates cursor.
+        auto find_key(const float* times, uint32_t count, float time, uint32_t& cursor) -> uint32_t;
+
+        // Overwrites the targets animated by clip, leaves all others untouched
+        auto sample(const Clip& clip, float time, ClipCursor& cursor, Pose& pose) -> void;
+
+        // Weighted blend of the non-additive layers, targets with a total weight below 1 are filled up with rest.
+        // Additive layers are applied afterwards in order. pose is resized to rest.
+        auto blend(const Pose& rest, const Layer* layers, size_t layer_count, Pose& pose) -> void;
+    }
+}
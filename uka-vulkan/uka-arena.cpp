@@ -0,0 +1,60 @@
+#include "uka-arena.hpp"
+
+#include <algorithm>
+
+namespace uka
+{
+    Uka_Arena::Uka_Arena(size_t default_block_size) : block_size(default_block_size)
+    {
+    }
+
+    Uka_Arena::~Uka_Arena()
+    {
+        reset();
+    }
+
+    auto Uka_Arena::add_block(size_t size) -> void
+    {
+        auto block = Block{};
+        block.size = std::max(size, block_size);
+        block.data.reset(new unsigned char[block.size]);
+        blocks.push_back(std::move(block));
+    }
+
+    auto Uka_Arena::allocate(size_t size, size_t alignment) -> void*
+    {
+        auto fits = [&](const Block& block, size_t& offset)
+        {
+            auto address = reinterpret_cast<uintptr_t>(block.data.get()) + block.used;
+            offset = block.used + ((alignment - address % alignment) % alignment);
+            return offset + size <= block.size;
+        };
+        auto offset = size_t{0};
+        if(blocks.empty() || !fits(blocks.back(), offset))
+        {
+            add_block(size + alignment);
+            fits(blocks.back(), offset);
+        }
+        auto& block = blocks.back();
+        block.used = offset + size;
+        return block.data.get() + offset;
+    }
+
+    auto Uka_Arena::reserve(size_t size) -> void
+    {
+        if(blocks.empty() || blocks.back().size - blocks.back().used < size)
+        {
+            add_block(size);
+        }
+    }
+
+    auto Uka_Arena::reset() -> void
+    {
+        for(auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+        {
+            it->destroy(it->object);
+        }
+        destructors.clear();
+        blocks.clear();
+    }
+}
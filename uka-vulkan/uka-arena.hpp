@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace uka
+{
+    // Bump allocator for objects that all die together. Memory comes in large blocks and is released in one go,
+    // destructors of non-trivial objects run in reverse creation order.
+    struct Uka_Arena
+    {
+    private:
+        struct Block
+        {
+            std::unique_ptr<unsigned char[]> data;
+            size_t size = 0;
+            size_t used = 0;
+        };
+        struct Destructor
+        {
+            void (*destroy)(void*);
+            void* object;
+        };
+        std::vector<Block> blocks;
+        std::vector<Destructor> destructors;
+        size_t block_size;
+
+        auto add_block(size_t size) -> void;
+    public:
+        explicit Uka_Arena(size_t block_size = 64 * 1024);
+        ~Uka_Arena();
+        Uka_Arena(const Uka_Arena&) = delete;
+        auto operator=(const Uka_Arena&) -> Uka_Arena& = delete;
+
+        auto allocate(size_t size, size_t alignment) -> void*;
+        // The next size bytes of allocations come from a single block, so they end up contiguous
+        auto reserve(size_t size) -> void;
+        // Destroys all objects and frees all blocks
+        auto reset() -> void;
+
+        template<typename T, typename... Args>
+        auto create(Args&&... args) -> T*
+        {
+            auto* object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if constexpr(!std::is_trivially_destructible_v<T>)
+            {
+                destructors.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, object});
+            }
+            return object;
+        }
+    };
+}
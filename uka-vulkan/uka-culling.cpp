@@ -0,0 +1,107 @@
+#include "uka-culling.hpp"
+
+#if defined(__AVX__)
+#define UKA_CULLING_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UKA_CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace uka
+{
+    namespace culling
+    {
+        auto Bounds::resize(size_t count) -> void
+        {
+            for(auto c = 0; c < 3; c++)
+            {
+                min[c].resize(count);
+                max[c].resize(count);
+            }
+        }
+
+        auto Bounds::set(size_t index, const float* box_min, const float* box_max) -> void
+        {
+            for(auto c = 0; c < 3; c++)
+            {
+                min[c][index] = box_min[c];
+                max[c][index] = box_max[c];
+            }
+        }
+
+        auto frustum_cull(const float* planes, const Bounds& bounds, uint8_t* visibility) -> Statistics
+        {
+            // The corner furthest along each plane normal decides, its choice only depends on the plane,
+            // so it is made once per plane instead of once per box
+            const float* corner[6][3];
+            for(auto p = 0; p < 6; p++)
+            {
+                for(auto c = 0; c < 3; c++)
+                {
+                    corner[p][c] = planes[p * 4 + c] >= 0.0f ? bounds.max[c].data() : bounds.min[c].data();
+                }
+            }
+            const auto count = bounds.size();
+            auto statistics = Statistics{};
+            auto i = size_t{0};
+#if UKA_CULLING_AVX
+            for(; i + 8 <= count; i += 8)
+            {
+                auto outside = _mm256_setzero_ps();
+                for(auto p = 0; p < 6; p++)
+                {
+                    const auto* plane = planes + p * 4;
+                    auto distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), _mm256_loadu_ps(corner[p][0] + i)), _mm256_set1_ps(plane[3]));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane[1]), _mm256_loadu_ps(corner[p][1] + i)));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane[2]), _mm256_loadu_ps(corner[p][2] + i)));
+                    outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+                }
+                auto mask = _mm256_movemask_ps(outside);
+                for(auto lane = 0; lane < 8; lane++)
+                {
+                    auto lane_outside = (mask >> lane) & 1;
+                    visibility[i + lane] = static_cast<uint8_t>(lane_outside ^ 1);
+                    statistics.culled += static_cast<uint32_t>(lane_outside);
+                }
+            }
+#elif UKA_CULLING_SSE
+            for(; i + 4 <= count; i += 4)
+            {
+                auto outside = _mm_setzero_ps();
+                for(auto p = 0; p < 6; p++)
+                {
+                    const auto* plane = planes + p * 4;
+                    auto distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), _mm_loadu_ps(corner[p][0] + i)), _mm_set1_ps(plane[3]));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[1]), _mm_loadu_ps(corner[p][1] + i)));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), _mm_loadu_ps(corner[p][2] + i)));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+                }
+                auto mask = _mm_movemask_ps(outside);
+                for(auto lane = 0; lane < 4; lane++)
+                {
+                    auto lane_outside = (mask >> lane) & 1;
+                    visibility[i + lane] = static_cast<uint8_t>(lane_outside ^ 1);
+                    statistics.culled += static_cast<uint32_t>(lane_outside);
+                }
+            }
+#endif
+            for(; i < count; i++)
+            {
+                auto visible = uint8_t{1};
+                for(auto p = 0; p < 6 && visible; p++)
+                {
+                    const auto* plane = planes + p * 4;
+                    if(plane[0] * corner[p][0][i] + plane[1] * corner[p][1][i] + plane[2] * corner[p][2][i] + plane[3] < 0.0f)
+                    {
+                        visible = 0;
+                    }
+                }
+                visibility[i] = visible;
+                statistics.culled += visible ^ 1u;
+            }
+            statistics.visible = static_cast<uint32_t>(count) - statistics.culled;
+            return statistics;
+        }
+    }
+}
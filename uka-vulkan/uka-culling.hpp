@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uka
+{
+    namespace culling
+    {
+        // Axis aligned boxes as structure of arrays, one SIMD lane tests one box
+        struct Bounds
+        {
+            std::vector<float> min[3];
+            std::vector<float> max[3];
+
+            auto size() const -> size_t { return min[0].size(); }
+            auto resize(size_t count) -> void;
+            auto set(size_t index, const float* box_min, const float* box_max) -> void;
+        };
+
+        struct Statistics
+        {
+            uint32_t visible = 0;
+            uint32_t culled = 0;
+        };
+
+        // planes are six xyzw planes with inward normals back to back, as in Uka_Frustum::planes.
+        // visibility[i] receives 1 when box i intersects the frustum and 0 when it lies fully outside a plane.
+        // Tests 8 boxes at a time with AVX, 4 with SSE2.
+        auto frustum_cull(const float* planes, const Bounds& bounds, uint8_t* visibility) -> Statistics;
+    }
+}
@@ -292,7 +292,7 @@ namespace uka
         VkCommandPool pool,
         bool begin) -> VkCommandBuffer
     {
-        auto command_buffer_info = uka::init::command_buffer_allocate_info(command_pool, level, 1);
+        auto command_buffer_info = uka::init::command_buffer_allocate_info(pool, level, 1);
         auto command_buffer = VkCommandBuffer{};
         VK_CHECK_RESULT(vkAllocateCommandBuffers(logical_device, &command_buffer_info, &command_buffer));
         if(begin)
@@ -309,6 +309,11 @@ namespace uka
     }
 
     auto Uka_Device::flush_command_buffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free)->void
+    {
+        flush_command_buffer(commandBuffer, queue, command_pool, free);
+    }
+
+    auto Uka_Device::flush_command_buffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)->void
     {
         if(commandBuffer == VK_NULL_HANDLE)
         {
@@ -326,16 +331,11 @@ namespace uka
         vkDestroyFence(logical_device, fence, nullptr);
         if(free)
         {
-            vkFreeCommandBuffers(logical_device, command_pool, 1, &commandBuffer);
+            vkFreeCommandBuffers(logical_device, pool, 1, &commandBuffer);
         }
 
     }
 
-    auto Uka_Device::flush_command_buffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)->void
-    {
-        flush_command_buffer(commandBuffer, queue, free);
-    }
-
     auto Uka_Device::extension_supported(const char *extension)->bool
     {
         return std::find(supported_extensions.begin(), supported_extensions.end(), extension) != supported_extensions.end();
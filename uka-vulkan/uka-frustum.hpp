@@ -0,0 +1,81 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include "uka-camera.hpp"
+
+namespace uka
+{
+    // Six view frustum planes in world space, normals point inwards
+    struct Uka_Frustum
+    {
+        enum side
+        {
+            left_plane = 0,
+            right_plane = 1,
+            bottom_plane = 2,
+            top_plane = 3,
+            near_plane = 4,
+            far_plane = 5,
+        };
+        glm::vec4 planes[6];
+
+        Uka_Frustum() = default;
+        explicit Uka_Frustum(const glm::mat4& view_projection)
+        {
+            update(view_projection);
+        }
+        explicit Uka_Frustum(const Uka_Camera& camera)
+        {
+            update(camera);
+        }
+
+        // Gribb/Hartmann plane extraction for a zero-to-one depth range
+        auto update(const glm::mat4& m) -> void
+        {
+            auto row = [&](int r) { return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+            planes[side::left_plane] = row(3) + row(0);
+            planes[side::right_plane] = row(3) - row(0);
+            planes[side::bottom_plane] = row(3) + row(1);
+            planes[side::top_plane] = row(3) - row(1);
+            planes[side::near_plane] = row(2);
+            planes[side::far_plane] = row(3) - row(2);
+            for(auto& plane : planes)
+            {
+                plane /= glm::length(glm::vec3(plane));
+            }
+        }
+
+        auto update(const Uka_Camera& camera) -> void
+        {
+            update(camera.matrices.perspective * camera.matrices.view);
+        }
+
+        auto sphere_visible(const glm::vec3& center, float radius) const -> bool
+        {
+            for(const auto& plane : planes)
+            {
+                if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Tests the box corner furthest along each plane normal, conservative near frustum edges
+        auto aabb_visible(const glm::vec3& min, const glm::vec3& max) const -> bool
+        {
+            for(const auto& plane : planes)
+            {
+                auto corner = glm::vec3(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+                if(glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
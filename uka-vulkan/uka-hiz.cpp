@@ -0,0 +1,179 @@
+#include "uka-hiz.hpp"
+
+#include <algorithm>
+
+namespace uka
+{
+    // Push constants of hiz.slang
+    struct HizReduction
+    {
+        int32_t source_size[2];
+        int32_t destination_size[2];
+    };
+
+    Uka_Hiz::~Uka_Hiz()
+    {
+        destroy();
+    }
+
+    auto Uka_Hiz::create(uint32_t depth_width, uint32_t depth_height, VkImageView depth_view, const std::string& shader_file, VkPipelineCache pipeline_cache) -> void
+    {
+        destroy();
+        width = std::max(depth_width / 2, 1u);
+        height = std::max(depth_height / 2, 1u);
+        mip_levels = 1;
+        while((std::max(width, height) >> mip_levels) > 0)
+        {
+            mip_levels++;
+        }
+
+        auto image_create_info = uka::init::image_create_info();
+        image_create_info.imageType = VK_IMAGE_TYPE_2D;
+        image_create_info.format = VK_FORMAT_R32_SFLOAT;
+        image_create_info.extent = {width, height, 1};
+        image_create_info.mipLevels = mip_levels;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VK_CHECK_RESULT(vkCreateImage(device->logical_device, &image_create_info, nullptr, &image));
+        auto mem_reqs = VkMemoryRequirements{};
+        vkGetImageMemoryRequirements(device->logical_device, image, &mem_reqs);
+        auto mem_alloc_info = uka::init::memory_allocate_info();
+        mem_alloc_info.allocationSize = mem_reqs.size;
+        mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK_RESULT(vkAllocateMemory(device->logical_device, &mem_alloc_info, nullptr, &memory));
+        VK_CHECK_RESULT(vkBindImageMemory(device->logical_device, image, memory, 0));
+
+        auto view_create_info = uka::init::image_view_create_info();
+        view_create_info.image = image;
+        view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_create_info.format = VK_FORMAT_R32_SFLOAT;
+        view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1};
+        VK_CHECK_RESULT(vkCreateImageView(device->logical_device, &view_create_info, nullptr, &view));
+        level_views.resize(mip_levels);
+        for(auto level = uint32_t{0}; level < mip_levels; level++)
+        {
+            view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            VK_CHECK_RESULT(vkCreateImageView(device->logical_device, &view_create_info, nullptr, &level_views[level]));
+        }
+
+        // One set per level, 0: source (the depth buffer or the level above), 1: destination level
+        std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
+            uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        };
+        auto set_layout_create_info = uka::init::descriptor_set_layout_create_info(set_layout_bindings);
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &set_layout_create_info, nullptr, &descriptor_set_layout));
+        std::vector<VkDescriptorPoolSize> pool_sizes = {
+            uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, mip_levels),
+            uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mip_levels),
+        };
+        auto pool_create_info = uka::init::descriptor_pool_create_info(pool_sizes, mip_levels);
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device->logical_device, &pool_create_info, nullptr, &descriptor_pool));
+        auto set_layouts = std::vector<VkDescriptorSetLayout>(mip_levels, descriptor_set_layout);
+        auto allocate_info = uka::init::descriptor_set_allocate_info(descriptor_pool, mip_levels, set_layouts.data());
+        descriptor_sets.resize(mip_levels);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &allocate_info, descriptor_sets.data()));
+        for(auto level = uint32_t{0}; level < mip_levels; level++)
+        {
+            auto source_info = level == 0
+                ? uka::init::descriptor_img_info(VK_NULL_HANDLE, depth_view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+                : uka::init::descriptor_img_info(VK_NULL_HANDLE, level_views[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+            auto destination_info = uka::init::descriptor_img_info(VK_NULL_HANDLE, level_views[level], VK_IMAGE_LAYOUT_GENERAL);
+            std::vector<VkWriteDescriptorSet> writes = {
+                uka::init::write_descriptor_set(descriptor_sets[level], 0, 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &source_info),
+                uka::init::write_descriptor_set(descriptor_sets[level], 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &destination_info),
+            };
+            vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+
+        auto pipeline_layout_create_info = uka::init::pipeline_layout_create_info(1, &descriptor_set_layout);
+        auto push_constant_range = uka::init::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HizReduction));
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device->logical_device, &pipeline_layout_create_info, nullptr, &pipeline_layout));
+
+        auto shader_stage = VkPipelineShaderStageCreateInfo{};
+        shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shader_stage.module = uka::tools::load_shader(shader_file, device->logical_device);
+        shader_stage.pName = "main";
+        assert(shader_stage.module != VK_NULL_HANDLE);
+        auto pipeline_create_info = uka::init::compute_pipeline_create_info(pipeline_layout);
+        pipeline_create_info.stage = shader_stage;
+        VK_CHECK_RESULT(vkCreateComputePipelines(device->logical_device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline));
+        vkDestroyShaderModule(device->logical_device, shader_stage.module, nullptr);
+        source_size[0] = depth_width;
+        source_size[1] = depth_height;
+    }
+
+    auto Uka_Hiz::build(VkCommandBuffer commandbuffer, const glm::mat4& depth_view_projection) -> void
+    {
+        if(pipeline == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        // Waits for the previous frame's occlusion tests, and moves a fresh image out of UNDEFINED
+        auto barrier = uka::init::image_memory_barrier();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = ready ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1};
+        vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        auto reduction = HizReduction{};
+        reduction.source_size[0] = static_cast<int32_t>(source_size[0]);
+        reduction.source_size[1] = static_cast<int32_t>(source_size[1]);
+        for(auto level = uint32_t{0}; level < mip_levels; level++)
+        {
+            reduction.destination_size[0] = static_cast<int32_t>(std::max(width >> level, 1u));
+            reduction.destination_size[1] = static_cast<int32_t>(std::max(height >> level, 1u));
+            vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[level], 0, nullptr);
+            vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(reduction), &reduction);
+            vkCmdDispatch(commandbuffer, (reduction.destination_size[0] + 7) / 8, (reduction.destination_size[1] + 7) / 8, 1);
+
+            // The next level reads this one, culling reads all of them
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            reduction.source_size[0] = reduction.destination_size[0];
+            reduction.source_size[1] = reduction.destination_size[1];
+        }
+        view_projection = depth_view_projection;
+        ready = true;
+    }
+
+    auto Uka_Hiz::destroy() -> void
+    {
+        if(image == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        vkDestroyPipeline(device->logical_device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device->logical_device, pipeline_layout, nullptr);
+        vkDestroyDescriptorPool(device->logical_device, descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(device->logical_device, descriptor_set_layout, nullptr);
+        for(auto level_view : level_views)
+        {
+            vkDestroyImageView(device->logical_device, level_view, nullptr);
+        }
+        vkDestroyImageView(device->logical_device, view, nullptr);
+        vkDestroyImage(device->logical_device, image, nullptr);
+        vkFreeMemory(device->logical_device, memory, nullptr);
+        level_views.clear();
+        descriptor_sets.clear();
+        image = VK_NULL_HANDLE;
+        pipeline = VK_NULL_HANDLE;
+        ready = false;
+    }
+}
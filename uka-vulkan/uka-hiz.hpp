@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "uka-device.hpp"
+#include "uka-tools.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace uka
+{
+    // Hierarchical depth pyramid for occlusion culling. Level 0 is half the depth buffer resolution and every texel
+    // holds the farthest depth of the texels below it, so a box whose nearest depth lies beyond it is hidden.
+    struct Uka_Hiz
+    {
+        Uka_Device* device = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mip_levels = 0;
+        // Resolution of the depth buffer the pyramid reduces
+        uint32_t source_size[2] = {};
+        // R32_SFLOAT, always in VK_IMAGE_LAYOUT_GENERAL
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<VkImageView> level_views;
+        // View-projection the pyramid's depth was rendered with, occlusion tests project boxes with it
+        glm::mat4 view_projection{1.0f};
+        // Set once build was recorded, culling ignores the pyramid before that
+        bool ready = false;
+
+        VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> descriptor_sets;
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+
+        explicit Uka_Hiz(Uka_Device* device) : device(device) {}
+        ~Uka_Hiz();
+        // depth_view is a depth aspect only view of a depth_width x depth_height image with the sampled usage,
+        // shader_file the compiled hiz.slang. Call again after the depth buffer was resized.
+        auto create(uint32_t depth_width, uint32_t depth_height, VkImageView depth_view, const std::string& shader_file, VkPipelineCache pipeline_cache = VK_NULL_HANDLE) -> void;
+        // Reduces the depth buffer into the pyramid. Record after the pass that wrote the depth, with the depth in
+        // VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL and its writes made visible to the compute stage.
+        auto build(VkCommandBuffer commandbuffer, const glm::mat4& depth_view_projection) -> void;
+        auto destroy() -> void;
+    };
+}
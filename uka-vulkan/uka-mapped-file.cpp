@@ -0,0 +1,134 @@
+#include "uka-mapped-file.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace uka
+{
+    Uka_Mapped_File::~Uka_Mapped_File()
+    {
+        close();
+    }
+
+    Uka_Mapped_File::Uka_Mapped_File(Uka_Mapped_File&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    auto Uka_Mapped_File::operator=(Uka_Mapped_File&& other) noexcept -> Uka_Mapped_File&
+    {
+        if(this != &other)
+        {
+            close();
+            path = std::move(other.path);
+            data = other.data;
+            size = other.size;
+#if defined(_WIN32)
+            file_handle = other.file_handle;
+            mapping_handle = other.mapping_handle;
+            other.file_handle = nullptr;
+            other.mapping_handle = nullptr;
+#endif
+            other.data = nullptr;
+            other.size = 0;
+        }
+        return *this;
+    }
+
+    auto Uka_Mapped_File::open(const std::string& file_path) -> bool
+    {
+        close();
+#if defined(_WIN32)
+        file_handle = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file_handle == INVALID_HANDLE_VALUE)
+        {
+            file_handle = nullptr;
+            return false;
+        }
+        auto file_size = LARGE_INTEGER{};
+        if(!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping_handle)
+        {
+            close();
+            return false;
+        }
+        data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        if(!data)
+        {
+            close();
+            return false;
+        }
+        size = static_cast<size_t>(file_size.QuadPart);
+#else
+        auto fd = ::open(file_path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat file_stat{};
+        if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        auto mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(mapping, static_cast<size_t>(file_stat.st_size), MADV_WILLNEED);
+        data = static_cast<const unsigned char*>(mapping);
+        size = static_cast<size_t>(file_stat.st_size);
+#endif
+        path = file_path;
+        return true;
+    }
+
+    auto Uka_Mapped_File::close() -> void
+    {
+#if defined(_WIN32)
+        if(data)
+        {
+            UnmapViewOfFile(data);
+        }
+        if(mapping_handle)
+        {
+            CloseHandle(mapping_handle);
+        }
+        if(file_handle)
+        {
+            CloseHandle(file_handle);
+        }
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+#else
+        if(data)
+        {
+            munmap(const_cast<unsigned char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        path.clear();
+    }
+
+    auto Uka_Mapped_File::is_open() const -> bool
+    {
+        return data != nullptr;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace uka
+{
+    // Read-only memory mapping of a whole file
+    struct Uka_Mapped_File
+    {
+        std::string path;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+
+        Uka_Mapped_File() = default;
+        ~Uka_Mapped_File();
+        Uka_Mapped_File(const Uka_Mapped_File&) = delete;
+        auto operator=(const Uka_Mapped_File&) -> Uka_Mapped_File& = delete;
+        Uka_Mapped_File(Uka_Mapped_File&& other) noexcept;
+        auto operator=(Uka_Mapped_File&& other) noexcept -> Uka_Mapped_File&;
+
+        auto open(const std::string& file_path) -> bool;
+        auto close() -> void;
+        auto is_open() const -> bool;
+    private:
+#if defined(_WIN32)
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,822 @@
+#include "uka-mesh-optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace uka
+{
+    namespace mesh
+    {
+        // Triangles adjacent to each vertex in CSR form
+        struct TriangleAdjacency
+        {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> triangles;
+
+            TriangleAdjacency(const uint32_t* indices, size_t index_count, uint32_t vertex_count)
+                : offsets(vertex_count + 1, 0), triangles(index_count)
+            {
+                for(auto i = size_t{0}; i < index_count; i++)
+                {
+                    offsets[indices[i] + 1]++;
+                }
+                for(auto v = uint32_t{0}; v < vertex_count; v++)
+                {
+                    offsets[v + 1] += offsets[v];
+                }
+                auto fill = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+                for(auto i = size_t{0}; i < index_count; i++)
+                {
+                    triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+                }
+            }
+        };
+
+        auto analyze_vertex_cache(const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size) -> VertexCacheStatistics
+        {
+            auto result = VertexCacheStatistics{};
+            if(index_count < 3 || vertex_count == 0)
+            {
+                return result;
+            }
+            // A vertex is in the FIFO while fewer than cache_size misses happened since it was loaded
+            auto cache_timestamps = std::vector<uint32_t>(vertex_count, 0);
+            auto timestamp = cache_size + 1;
+            auto misses = size_t{0};
+            for(auto i = size_t{0}; i < index_count; i++)
+            {
+                auto v = indices[i];
+                if(timestamp - cache_timestamps[v] > cache_size)
+                {
+                    cache_timestamps[v] = timestamp++;
+                    misses++;
+                }
+            }
+            result.acmr = static_cast<float>(misses) / static_cast<float>(index_count / 3);
+            result.atvr = static_cast<float>(misses) / static_cast<float>(vertex_count);
+            return result;
+        }
+
+        auto optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size) -> void
+        {
+            const auto triangle_count = index_count / 3;
+            if(triangle_count == 0 || vertex_count == 0)
+            {
+                return;
+            }
+            const auto adjacency = TriangleAdjacency(indices, index_count, vertex_count);
+            auto live_triangles = std::vector<uint32_t>(vertex_count);
+            for(auto v = uint32_t{0}; v < vertex_count; v++)
+            {
+                live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+            }
+            auto cache_timestamps = std::vector<uint32_t>(vertex_count, 0);
+            auto emitted = std::vector<bool>(triangle_count, false);
+            auto dead_end = std::vector<uint32_t>();
+            auto candidates = std::vector<uint32_t>();
+            auto result = std::vector<uint32_t>();
+            result.reserve(triangle_count * 3);
+
+            auto timestamp = cache_size + 1;
+            auto cursor = uint32_t{0};
+            auto fanning = int64_t{0};
+            while(fanning >= 0)
+            {
+                candidates.clear();
+                const auto vertex = static_cast<uint32_t>(fanning);
+                for(auto t = adjacency.offsets[vertex]; t < adjacency.offsets[vertex + 1]; t++)
+                {
+                    auto triangle = adjacency.triangles[t];
+                    if(emitted[triangle])
+                    {
+                        continue;
+                    }
+                    emitted[triangle] = true;
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        auto v = indices[triangle * 3 + k];
+                        result.push_back(v);
+                        dead_end.push_back(v);
+                        candidates.push_back(v);
+                        live_triangles[v]--;
+                        if(timestamp - cache_timestamps[v] > cache_size)
+                        {
+                            cache_timestamps[v] = timestamp++;
+                        }
+                    }
+                }
+
+                // Prefer the candidate that stays in the cache longest while its remaining triangles are fanned
+                fanning = -1;
+                auto best_priority = int64_t{-1};
+                for(auto v : candidates)
+                {
+                    if(live_triangles[v] == 0)
+                    {
+                        continue;
+                    }
+                    auto priority = int64_t{0};
+                    auto age = int64_t{timestamp} - cache_timestamps[v];
+                    if(age + 2 * int64_t{live_triangles[v]} <= cache_size)
+                    {
+                        priority = age;
+                    }
+                    if(priority > best_priority)
+                    {
+                        best_priority = priority;
+                        fanning = v;
+                    }
+                }
+                if(fanning >= 0)
+                {
+                    continue;
+                }
+                while(!dead_end.empty())
+                {
+                    auto v = dead_end.back();
+                    dead_end.pop_back();
+                    if(live_triangles[v] > 0)
+                    {
+                        fanning = v;
+                        break;
+                    }
+                }
+                if(fanning >= 0)
+                {
+                    continue;
+                }
+                while(cursor < vertex_count)
+                {
+                    if(live_triangles[cursor] > 0)
+                    {
+                        fanning = cursor;
+                        break;
+                    }
+                    cursor++;
+                }
+            }
+            std::copy(result.begin(), result.end(), indices);
+        }
+
+        auto optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, uint32_t cache_size) -> void
+        {
+            const auto triangle_count = index_count / 3;
+            if(triangle_count < 2 || vertex_count == 0)
+            {
+                return;
+            }
+            auto position = [&](uint32_t v) -> const float*
+            {
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * position_stride);
+            };
+
+            // Cluster boundaries are triangles that miss on all three vertices, moving a cluster there keeps the cache behaviour
+            auto cluster_starts = std::vector<size_t>{0};
+            auto cache_timestamps = std::vector<uint32_t>(vertex_count, 0);
+            auto timestamp = cache_size + 1;
+            for(auto t = size_t{0}; t < triangle_count; t++)
+            {
+                auto misses = 0;
+                for(auto k = 0; k < 3; k++)
+                {
+                    auto v = indices[t * 3 + k];
+                    if(timestamp - cache_timestamps[v] > cache_size)
+                    {
+                        cache_timestamps[v] = timestamp++;
+                        misses++;
+                    }
+                }
+                if(misses == 3 && t != cluster_starts.back())
+                {
+                    cluster_starts.push_back(t);
+                }
+            }
+            cluster_starts.push_back(triangle_count);
+
+            float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+            for(auto i = size_t{0}; i < index_count; i++)
+            {
+                auto p = position(indices[i]);
+                mesh_centroid[0] += p[0];
+                mesh_centroid[1] += p[1];
+                mesh_centroid[2] += p[2];
+            }
+            for(auto& c : mesh_centroid)
+            {
+                c /= static_cast<float>(index_count);
+            }
+
+            // Clusters facing away from the mesh centre are likely occluders, draw them first
+            const auto cluster_count = cluster_starts.size() - 1;
+            auto sort_keys = std::vector<float>(cluster_count);
+            for(auto c = size_t{0}; c < cluster_count; c++)
+            {
+                float centroid[3] = {0.0f, 0.0f, 0.0f};
+                float normal[3] = {0.0f, 0.0f, 0.0f};
+                for(auto t = cluster_starts[c]; t < cluster_starts[c + 1]; t++)
+                {
+                    auto p0 = position(indices[t * 3 + 0]);
+                    auto p1 = position(indices[t * 3 + 1]);
+                    auto p2 = position(indices[t * 3 + 2]);
+                    float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                    float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                    normal[0] += e0[1] * e1[2] - e0[2] * e1[1];
+                    normal[1] += e0[2] * e1[0] - e0[0] * e1[2];
+                    normal[2] += e0[0] * e1[1] - e0[1] * e1[0];
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f;
+                    }
+                }
+                auto count = static_cast<float>(cluster_starts[c + 1] - cluster_starts[c]);
+                auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                auto key = 0.0f;
+                for(auto k = 0; k < 3; k++)
+                {
+                    key += (centroid[k] / count - mesh_centroid[k]) * (length > 0.0f ? normal[k] / length : 0.0f);
+                }
+                sort_keys[c] = key;
+            }
+
+            auto order = std::vector<uint32_t>(cluster_count);
+            for(auto c = uint32_t{0}; c < cluster_count; c++)
+            {
+                order[c] = c;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+            auto result = std::vector<uint32_t>();
+            result.reserve(triangle_count * 3);
+            for(auto c : order)
+            {
+                result.insert(result.end(), indices + cluster_starts[c] * 3, indices + cluster_starts[c + 1] * 3);
+            }
+            std::copy(result.begin(), result.end(), indices);
+        }
+
+        static auto compute_meshlet_bounds(Meshlet& meshlet, const uint32_t* indices, const float* positions, size_t position_stride) -> void
+        {
+            auto position = [&](uint32_t v) -> const float*
+            {
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * position_stride);
+            };
+            const auto* triangles = indices + meshlet.first_index;
+            const auto index_count = meshlet.triangle_count * 3;
+
+            // Sphere around the box centre, loose but cheap and good enough for culling
+            float min[3] = {position(triangles[0])[0], position(triangles[0])[1], position(triangles[0])[2]};
+            float max[3] = {min[0], min[1], min[2]};
+            for(auto i = uint32_t{1}; i < index_count; i++)
+            {
+                auto p = position(triangles[i]);
+                for(auto k = 0; k < 3; k++)
+                {
+                    min[k] = std::min(min[k], p[k]);
+                    max[k] = std::max(max[k], p[k]);
+                }
+            }
+            auto radius_squared = 0.0f;
+            for(auto k = 0; k < 3; k++)
+            {
+                meshlet.center[k] = (min[k] + max[k]) * 0.5f;
+            }
+            for(auto i = uint32_t{0}; i < index_count; i++)
+            {
+                auto p = position(triangles[i]);
+                auto dx = p[0] - meshlet.center[0];
+                auto dy = p[1] - meshlet.center[1];
+                auto dz = p[2] - meshlet.center[2];
+                radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+            }
+            meshlet.radius = std::sqrt(radius_squared);
+
+            auto normals = std::vector<float>(meshlet.triangle_count * 3, 0.0f);
+            float axis[3] = {0.0f, 0.0f, 0.0f};
+            for(auto t = uint32_t{0}; t < meshlet.triangle_count; t++)
+            {
+                auto p0 = position(triangles[t * 3 + 0]);
+                auto p1 = position(triangles[t * 3 + 1]);
+                auto p2 = position(triangles[t * 3 + 2]);
+                float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                float n[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+                auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if(length > 0.0f)
+                {
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        normals[t * 3 + k] = n[k] / length;
+                        axis[k] += n[k] / length;
+                    }
+                }
+            }
+            auto axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            // A cutoff above 1 never culls, used for degenerate clusters and cones wider than a hemisphere
+            meshlet.cone_cutoff = 2.0f;
+            meshlet.cone_axis[0] = 0.0f;
+            meshlet.cone_axis[1] = 0.0f;
+            meshlet.cone_axis[2] = 1.0f;
+            if(axis_length <= 0.0f)
+            {
+                return;
+            }
+            auto min_dot = 1.0f;
+            for(auto t = uint32_t{0}; t < meshlet.triangle_count; t++)
+            {
+                auto dot = (normals[t * 3 + 0] * axis[0] + normals[t * 3 + 1] * axis[1] + normals[t * 3 + 2] * axis[2]) / axis_length;
+                min_dot = std::min(min_dot, dot);
+            }
+            for(auto k = 0; k < 3; k++)
+            {
+                meshlet.cone_axis[k] = axis[k] / axis_length;
+            }
+            if(min_dot > 0.0f)
+            {
+                meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+            }
+        }
+
+        auto build_meshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, uint32_t max_vertices, uint32_t max_triangles) -> std::vector<Meshlet>
+        {
+            auto meshlets = std::vector<Meshlet>();
+            const auto triangle_count = index_count / 3;
+            if(triangle_count == 0 || vertex_count == 0)
+            {
+                return meshlets;
+            }
+            // marker[v] holds the meshlet number + 1 that last referenced v
+            auto marker = std::vector<uint32_t>(vertex_count, 0);
+            auto current = Meshlet{};
+            auto flush = [&](uint32_t next_triangle)
+            {
+                if(current.triangle_count > 0)
+                {
+                    compute_meshlet_bounds(current, indices, positions, position_stride);
+                    meshlets.push_back(current);
+                }
+                current = Meshlet{};
+                current.first_index = next_triangle * 3;
+            };
+            for(auto t = uint32_t{0}; t < triangle_count; t++)
+            {
+                auto id = static_cast<uint32_t>(meshlets.size()) + 1;
+                auto new_vertices = uint32_t{0};
+                for(auto k = 0; k < 3; k++)
+                {
+                    new_vertices += marker[indices[t * 3 + k]] != id ? 1 : 0;
+                }
+                if(current.vertex_count + new_vertices > max_vertices || current.triangle_count + 1 > max_triangles)
+                {
+                    flush(t);
+                    id = static_cast<uint32_t>(meshlets.size()) + 1;
+                }
+                for(auto k = 0; k < 3; k++)
+                {
+                    auto v = indices[t * 3 + k];
+                    if(marker[v] != id)
+                    {
+                        marker[v] = id;
+                        current.vertex_count++;
+                    }
+                }
+                current.triangle_count++;
+            }
+            flush(static_cast<uint32_t>(triangle_count));
+            return meshlets;
+        }
+
+        // Symmetric 4x4 error quadric stored as its 10 unique coefficients
+        struct Quadric
+        {
+            double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+            double a11 = 0, a12 = 0, a13 = 0;
+            double a22 = 0, a23 = 0;
+            double a33 = 0;
+            double weight = 0;
+
+            auto add(const Quadric& q) -> void
+            {
+                a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+                a11 += q.a11; a12 += q.a12; a13 += q.a13;
+                a22 += q.a22; a23 += q.a23;
+                a33 += q.a33;
+                weight += q.weight;
+            }
+
+            // Weighted mean squared distance to the accumulated planes
+            auto error(const float* p) const -> double
+            {
+                double x = p[0], y = p[1], z = p[2];
+                auto sum = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                     + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                     + a22 * z * z + 2 * a23 * z
+                     + a33;
+                return weight > 0 ? std::abs(sum) / weight : 0.0;
+            }
+
+            static auto from_plane(double a, double b, double c, double d, double weight) -> Quadric
+            {
+                auto q = Quadric{};
+                q.a00 = a * a * weight; q.a01 = a * b * weight; q.a02 = a * c * weight; q.a03 = a * d * weight;
+                q.a11 = b * b * weight; q.a12 = b * c * weight; q.a13 = b * d * weight;
+                q.a22 = c * c * weight; q.a23 = c * d * weight;
+                q.a33 = d * d * weight;
+                q.weight = weight;
+                return q;
+            }
+        };
+
+        // Distance from p to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+        static auto point_triangle_distance(const float* p, const float* a, const float* b, const float* c) -> double
+        {
+            auto sub = [](const float* x, const float* y, double* out) { out[0] = double(x[0]) - y[0]; out[1] = double(x[1]) - y[1]; out[2] = double(x[2]) - y[2]; };
+            auto dot = [](const double* x, const double* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+            double ab[3], ac[3], ap[3], bp[3], cp[3];
+            sub(b, a, ab);
+            sub(c, a, ac);
+            sub(p, a, ap);
+            sub(p, b, bp);
+            sub(p, c, cp);
+            auto closest = [&](double v, double w)
+            {
+                double d[3];
+                for(auto k = 0; k < 3; k++)
+                {
+                    d[k] = ap[k] - ab[k] * v - ac[k] * w;
+                }
+                return std::sqrt(dot(d, d));
+            };
+            auto d1 = dot(ab, ap), d2 = dot(ac, ap);
+            if(d1 <= 0.0 && d2 <= 0.0)
+            {
+                return closest(0.0, 0.0);
+            }
+            auto d3 = dot(ab, bp), d4 = dot(ac, bp);
+            if(d3 >= 0.0 && d4 <= d3)
+            {
+                return closest(1.0, 0.0);
+            }
+            auto vc = d1 * d4 - d3 * d2;
+            if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+            {
+                return closest(d1 / (d1 - d3), 0.0);
+            }
+            auto d5 = dot(ab, cp), d6 = dot(ac, cp);
+            if(d6 >= 0.0 && d5 <= d6)
+            {
+                return closest(0.0, 1.0);
+            }
+            auto vb = d5 * d2 - d1 * d6;
+            if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+            {
+                return closest(0.0, d2 / (d2 - d6));
+            }
+            auto va = d3 * d6 - d5 * d4;
+            if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+            {
+                auto w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                return closest(1.0 - w, w);
+            }
+            auto denominator = va + vb + vc;
+            if(denominator == 0.0)
+            {
+                return closest(0.0, 0.0);
+            }
+            return closest(vb / denominator, vc / denominator);
+        }
+
+        auto simplify(const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, size_t target_index_count, float target_error, float* result_error) -> std::vector<uint32_t>
+        {
+            auto result = std::vector<uint32_t>(indices, indices + index_count);
+            if(result_error)
+            {
+                *result_error = 0.0f;
+            }
+            const auto triangle_count = index_count / 3;
+            if(triangle_count == 0 || vertex_count == 0 || index_count <= target_index_count)
+            {
+                return result;
+            }
+            auto position = [&](uint32_t v) -> const float*
+            {
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * position_stride);
+            };
+            auto edge_key = [](uint32_t a, uint32_t b) -> uint64_t
+            {
+                return a < b ? (uint64_t{a} << 32) | b : (uint64_t{b} << 32) | a;
+            };
+
+            // Border vertices and attribute seams (several vertices on one position) stay put so the outline and UV layout survive
+            auto locked = std::vector<bool>(vertex_count, false);
+            {
+                auto edge_use = std::unordered_map<uint64_t, uint32_t>();
+                edge_use.reserve(index_count);
+                for(auto t = size_t{0}; t < triangle_count; t++)
+                {
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        edge_use[edge_key(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3])]++;
+                    }
+                }
+                for(const auto& edge : edge_use)
+                {
+                    if(edge.second == 1)
+                    {
+                        locked[edge.first >> 32] = true;
+                        locked[edge.first & 0xffffffffu] = true;
+                    }
+                }
+                auto first_at_position = std::unordered_map<uint64_t, uint32_t>();
+                for(auto v = uint32_t{0}; v < vertex_count; v++)
+                {
+                    auto p = position(v);
+                    uint32_t bits[3];
+                    memcpy(bits, p, sizeof(bits));
+                    auto hash = (uint64_t{bits[0]} * 73856093u) ^ (uint64_t{bits[1]} * 19349663u) ^ (uint64_t{bits[2]} * 83492791u);
+                    auto found = first_at_position.emplace(hash, v);
+                    if(!found.second && memcmp(position(found.first->second), p, sizeof(bits)) == 0)
+                    {
+                        locked[v] = true;
+                        locked[found.first->second] = true;
+                    }
+                }
+            }
+
+            auto quadrics = std::vector<Quadric>(vertex_count);
+            for(auto t = size_t{0}; t < triangle_count; t++)
+            {
+                auto p0 = position(result[t * 3 + 0]);
+                auto p1 = position(result[t * 3 + 1]);
+                auto p2 = position(result[t * 3 + 2]);
+                double e0[3] = {double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2]};
+                double e1[3] = {double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2]};
+                double n[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+                auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if(length <= 0.0)
+                {
+                    continue;
+                }
+                for(auto& c : n)
+                {
+                    c /= length;
+                }
+                // Area weighted so large faces resist being folded by small ones
+                auto q = Quadric::from_plane(n[0], n[1], n[2], -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]), length * 0.5);
+                for(auto k = 0; k < 3; k++)
+                {
+                    quadrics[result[t * 3 + k]].add(q);
+                }
+            }
+
+            auto adjacency = std::vector<std::vector<uint32_t>>(vertex_count);
+            for(auto t = uint32_t{0}; t < triangle_count; t++)
+            {
+                for(auto k = 0; k < 3; k++)
+                {
+                    adjacency[result[t * 3 + k]].push_back(t);
+                }
+            }
+            auto removed = std::vector<bool>(triangle_count, false);
+            auto alive_triangles = triangle_count;
+
+            struct Collapse
+            {
+                double cost;
+                uint32_t from;
+                uint32_t to;
+                uint32_t version;
+                auto operator<(const Collapse& other) const -> bool { return cost > other.cost; }
+            };
+            auto version = std::vector<uint32_t>(vertex_count, 0);
+            auto queue = std::priority_queue<Collapse>();
+            auto push_edge = [&](uint32_t a, uint32_t b)
+            {
+                // Both directions, a locked vertex can only be a target
+                if(!locked[a])
+                {
+                    auto q = quadrics[a];
+                    q.add(quadrics[b]);
+                    queue.push({q.error(position(b)), a, b, version[a]});
+                }
+                if(!locked[b])
+                {
+                    auto q = quadrics[b];
+                    q.add(quadrics[a]);
+                    queue.push({q.error(position(a)), b, a, version[b]});
+                }
+            };
+            for(auto t = size_t{0}; t < triangle_count; t++)
+            {
+                for(auto k = 0; k < 3; k++)
+                {
+                    auto a = result[t * 3 + k];
+                    auto b = result[t * 3 + (k + 1) % 3];
+                    if(a < b)
+                    {
+                        push_edge(a, b);
+                    }
+                }
+            }
+
+            auto triangle_normal = [&](uint32_t t, uint32_t replace, uint32_t with, double* n)
+            {
+                const float* p[3];
+                for(auto k = 0; k < 3; k++)
+                {
+                    auto v = result[t * 3 + k];
+                    p[k] = position(v == replace ? with : v);
+                }
+                double e0[3] = {double(p[1][0]) - p[0][0], double(p[1][1]) - p[0][1], double(p[1][2]) - p[0][2]};
+                double e1[3] = {double(p[2][0]) - p[0][0], double(p[2][1]) - p[0][1], double(p[2][2]) - p[0][2]};
+                n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+                n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+                n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+            };
+
+            const auto max_cost = double(target_error) * double(target_error);
+            // Vertex each one was collapsed into, chains are resolved when measuring the error
+            auto collapsed_into = std::vector<uint32_t>(vertex_count);
+            for(auto v = uint32_t{0}; v < vertex_count; v++)
+            {
+                collapsed_into[v] = v;
+            }
+            while(!queue.empty() && alive_triangles * 3 > target_index_count)
+            {
+                auto collapse = queue.top();
+                queue.pop();
+                if(collapse.version != version[collapse.from] || collapse.cost > max_cost)
+                {
+                    if(collapse.cost > max_cost && collapse.version == version[collapse.from])
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                const auto from = collapse.from;
+                const auto to = collapse.to;
+
+                // Reject collapses that flip a surviving triangle
+                auto shares_edge = false;
+                auto flips = false;
+                for(auto t : adjacency[from])
+                {
+                    if(removed[t])
+                    {
+                        continue;
+                    }
+                    auto has_to = result[t * 3] == to || result[t * 3 + 1] == to || result[t * 3 + 2] == to;
+                    shares_edge = shares_edge || has_to;
+                    if(has_to)
+                    {
+                        continue;
+                    }
+                    double before[3], after[3];
+                    triangle_normal(t, from, from, before);
+                    triangle_normal(t, from, to, after);
+                    if(before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+                    {
+                        flips = true;
+                        break;
+                    }
+                }
+                if(!shares_edge || flips)
+                {
+                    continue;
+                }
+
+                collapsed_into[from] = to;
+                quadrics[to].add(quadrics[from]);
+                version[from]++;
+                version[to]++;
+                locked[from] = true;
+                for(auto t : adjacency[from])
+                {
+                    if(removed[t])
+                    {
+                        continue;
+                    }
+                    auto has_to = result[t * 3] == to || result[t * 3 + 1] == to || result[t * 3 + 2] == to;
+                    if(has_to)
+                    {
+                        removed[t] = true;
+                        alive_triangles--;
+                        continue;
+                    }
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        if(result[t * 3 + k] == from)
+                        {
+                            result[t * 3 + k] = to;
+                        }
+                    }
+                    adjacency[to].push_back(t);
+                }
+                adjacency[from].clear();
+                for(auto t : adjacency[to])
+                {
+                    if(removed[t])
+                    {
+                        continue;
+                    }
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        auto v = result[t * 3 + k];
+                        if(v != to)
+                        {
+                            version[v]++;
+                        }
+                    }
+                }
+                for(auto t : adjacency[to])
+                {
+                    if(removed[t])
+                    {
+                        continue;
+                    }
+                    for(auto k = 0; k < 3; k++)
+                    {
+                        auto v = result[t * 3 + k];
+                        if(v != to)
+                        {
+                            push_edge(to, v);
+                        }
+                    }
+                }
+            }
+
+            if(result_error)
+            {
+                // The quadric cost is a weighted mean, so measure every collapsed vertex against the surviving fan
+                // around the vertex it ended up in. The fan distance bounds the distance to the whole surface from above.
+                auto max_distance = 0.0;
+                for(auto v = uint32_t{0}; v < vertex_count; v++)
+                {
+                    auto target = collapsed_into[v];
+                    if(target == v)
+                    {
+                        continue;
+                    }
+                    while(collapsed_into[target] != target)
+                    {
+                        target = collapsed_into[target];
+                    }
+                    auto distance = std::numeric_limits<double>::max();
+                    for(auto t : adjacency[target])
+                    {
+                        if(!removed[t])
+                        {
+                            distance = std::min(distance, point_triangle_distance(position(v), position(result[t * 3]), position(result[t * 3 + 1]), position(result[t * 3 + 2])));
+                        }
+                    }
+                    if(distance != std::numeric_limits<double>::max())
+                    {
+                        max_distance = std::max(max_distance, distance);
+                    }
+                }
+                *result_error = static_cast<float>(max_distance);
+            }
+
+            auto compacted = size_t{0};
+            for(auto t = size_t{0}; t < triangle_count; t++)
+            {
+                if(!removed[t])
+                {
+                    result[compacted++] = result[t * 3 + 0];
+                    result[compacted++] = result[t * 3 + 1];
+                    result[compacted++] = result[t * 3 + 2];
+                }
+            }
+            result.resize(compacted);
+            return result;
+        }
+
+        auto optimize_vertex_fetch(uint32_t* indices, size_t index_count, uint32_t vertex_count, std::vector<uint32_t>& remap) -> uint32_t
+        {
+            const auto unused = ~uint32_t{0};
+            remap.assign(vertex_count, unused);
+            auto next = uint32_t{0};
+            for(auto i = size_t{0}; i < index_count; i++)
+            {
+                auto& target = remap[indices[i]];
+                if(target == unused)
+                {
+                    target = next++;
+                }
+                indices[i] = target;
+            }
+            auto referenced = next;
+            for(auto& target : remap)
+            {
+                if(target == unused)
+                {
+                    target = next++;
+                }
+            }
+            return referenced;
+        }
+    }
+}
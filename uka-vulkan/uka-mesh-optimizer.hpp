@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uka
+{
+    namespace mesh
+    {
+        struct VertexCacheStatistics
+        {
+            // Average cache miss ratio, vertex transforms per triangle (0.5 is the ideal for large meshes)
+            float acmr = 0.0f;
+            // Average transform to vertex ratio, 1.0 means every vertex is transformed exactly once
+            float atvr = 0.0f;
+        };
+
+        // A run of consecutive triangles in a primitive's index range with at most max_vertices unique vertices
+        struct Meshlet
+        {
+            uint32_t first_index;
+            uint32_t triangle_count;
+            uint32_t vertex_count;
+            // Bounding sphere
+            float center[3];
+            float radius;
+            // Backface cone, the cluster faces away from the viewer when
+            // dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius
+            float cone_axis[3];
+            float cone_cutoff;
+        };
+
+        // All functions take triangle lists with indices local to the mesh, in [0, vertex_count)
+
+        // Simulates a FIFO post-transform cache of cache_size entries
+        auto analyze_vertex_cache(const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size = 16) -> VertexCacheStatistics;
+
+        // Tipsify (Sander et al. 2007) triangle reordering for post-transform cache locality
+        auto optimize_vertex_cache(uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size = 16) -> void;
+
+        // Splits a cache-optimized list into clusters at cache flushes and sorts the clusters outside-in,
+        // so front faces tend to be drawn before what they occlude. positions point at float3 with the given stride.
+        auto optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, uint32_t cache_size = 16) -> void;
+
+        // Splits the triangle list into meshlets in index order, run it after optimize_vertex_cache for compact clusters.
+        // first_index of the returned meshlets is relative to indices.
+        auto build_meshlets(const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, uint32_t max_vertices = 64, uint32_t max_triangles = 124) -> std::vector<Meshlet>;
+
+        // Quadric error edge-collapse simplification down to target_index_count indices, stopping early once a collapse's
+        // area weighted RMS plane distance would exceed target_error (in position units). Vertices are only moved onto
+        // existing vertices, borders and attribute seams are kept. result_error receives the largest distance of a removed
+        // vertex from the simplified surface, an upper bound measured against the triangles around where it collapsed to.
+        auto simplify(const uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, uint32_t vertex_count, size_t target_index_count, float target_error, float* result_error = nullptr) -> std::vector<uint32_t>;
+
+        // Renumbers vertices in order of first use and rewrites the indices.
+        // remap[old] = new, unreferenced vertices are moved to the end. Returns the referenced vertex count.
+        auto optimize_vertex_fetch(uint32_t* indices, size_t index_count, uint32_t vertex_count, std::vector<uint32_t>& remap) -> uint32_t;
+    }
+}
@@ -3,17 +3,35 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "uka-model.hpp"
+#include "uka-thread-pool.hpp"
+#include "uka-radix-sort.hpp"
+#include "uka-texture.hpp"
+#include "uka-pixel.hpp"
 #include <cstddef>
+#include <glm/gtc/packing.hpp>
+#include <array>
+#include <filesystem>
+#include <unordered_map>
 
 VkDescriptorSetLayout uka::gltf::descriptor_set_layout_image = VK_NULL_HANDLE;
-VkDescriptorSetLayout uka::gltf::descriptor_set_layout_ubo = VK_NULL_HANDLE;
+VkDescriptorSetLayout uka::gltf::descriptor_set_layout_bindless = VK_NULL_HANDLE;
+uint32_t uka::gltf::max_bindless_textures = 4096;
+uint32_t uka::gltf::streaming_tail_size = 64;
+VkDeviceSize uka::gltf::streaming_batch_size = 32 * 1024 * 1024;
+VkDescriptorSetLayout uka::gltf::descriptor_set_layout_transforms = VK_NULL_HANDLE;
+uint32_t uka::gltf::frames_in_flight = 2;
 VkMemoryPropertyFlags uka::gltf::memory_property_flags = 0;
 uint32_t uka::gltf::descriptor_binding_flags = uka::gltf::DescriptorBindingFlags::image_base_color;
+uint32_t uka::gltf::vertex_compression = uka::gltf::VertexCompression::COMPRESS_NONE;
+std::string uka::gltf::model_cache_directory;
+bool uka::gltf::draw_indirect_count = false;
+uka::gltf::WeldTolerances uka::gltf::weld_tolerances;
 
 auto load_image_data_function(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) ->bool
 {
     if (image->uri.find_last_of(".") != std::string::npos) {
-        if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
+        const auto extension = image->uri.substr(image->uri.find_last_of(".") + 1);
+        if (extension == "ktx" || extension == "ktx2") {
             return true;
         }
     }
@@ -41,46 +59,74 @@ auto uka::gltf::Texture::destroy() -> void
     vkFreeMemory(device->logical_device, device_memory, nullptr);
 }
 
+static auto is_ktx_image(const tinygltf::Image& gltf_image) -> bool
+{
+    const auto dot = gltf_image.uri.find_last_of(".");
+    if(dot == std::string::npos)
+    {
+        return false;
+    }
+    const auto extension = gltf_image.uri.substr(dot + 1);
+    return extension == "ktx" || extension == "ktx2";
+}
+
+auto uka::gltf::Texture::open_ktx(const tinygltf::Image& gltf_image, const std::string& path, uka::Uka_Device* device) -> KtxImage
+{
+    auto filename = path + "/" + gltf_image.uri;
+    if(!uka::tools::file_exists(filename))
+    {
+        uka::tools::exitFatal("File not found: " + filename,-1);
+    }
+    auto ktx_image = KtxImage{};
+    auto result = uka::load_ktx_file(filename, device, &ktx_image.texture, ktx_image.format);
+    assert(result == KTX_SUCCESS);
+    return ktx_image;
+}
+
+auto uka::gltf::Texture::staging_size(const tinygltf::Image& gltf_image, const std::string& path, const KtxImage& ktx_image) -> VkDeviceSize
+{
+    // Staging offsets are aligned to this, enough for any texel or block size
+    constexpr auto alignment = VkDeviceSize{16};
+    if(ktx_image.texture != nullptr)
+    {
+        return ktxTexture_GetDataSize(ktx_image.texture) + alignment;
+    }
+    if(is_ktx_image(gltf_image))
+    {
+        // The level data of a KTX1 file never exceeds the file holding it
+        auto error = std::error_code{};
+        const auto file_size = std::filesystem::file_size(path + "/" + gltf_image.uri, error);
+        return error ? 0 : static_cast<VkDeviceSize>(file_size) + alignment;
+    }
+    return static_cast<VkDeviceSize>(gltf_image.width) * gltf_image.height * 4 + alignment;
+}
+
 auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
     std::string path,
     uka::Uka_Device* device,
     VkQueue copy_queue) -> void
+{
+    // KTX2 data can outgrow its file once inflated, open it first for the exact size
+    auto ktx_image = is_ktx_image(gltf_image) ? open_ktx(gltf_image, path, device) : KtxImage{};
+    auto batch = Uka_Upload_Batch(device);
+    batch.begin(staging_size(gltf_image, path, ktx_image));
+    from_gltf_image(gltf_image, path, device, batch, ktx_image);
+    batch.submit(copy_queue);
+}
+
+auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
+    std::string path,
+    uka::Uka_Device* device,
+    Uka_Upload_Batch& batch,
+    KtxImage ktx_image) -> void
 {
     this->device = device;
-    auto is_ktx = false;
-    if (gltf_image.uri.find_last_of(".") != std::string::npos) {
-        if (gltf_image.uri.substr(gltf_image.uri.find_last_of(".") + 1) == "ktx") {
-            is_ktx = true;
-        }
-    }
+    const auto is_ktx = is_ktx_image(gltf_image);
+    auto copy_cmd = batch.command_buffer;
 
     auto format = VkFormat{};
     if(!is_ktx)
     {
-        unsigned char* buffer = nullptr;
-        auto buffer_size = 0;
-        auto delete_buffer = false;
-        if(gltf_image.component == 3)
-        {
-            buffer_size = gltf_image.width * gltf_image.height * 4;
-            buffer = new unsigned char[buffer_size];
-            auto rgba = buffer;
-            auto rgb = &gltf_image.image[0];
-            for (size_t i = 0; i < gltf_image.width * gltf_image.height; ++i) {
-                for (int32_t j = 0; j < 3; ++j) {
-                    rgba[j] = rgb[j];
-                }
-                rgba += 4;
-                rgb += 3;
-            }
-            delete_buffer = true;
-        }
-        else
-        {
-            buffer = const_cast<unsigned char*>(&gltf_image.image[0]);
-            buffer_size = gltf_image.image.size();
-        }
-
         format = VK_FORMAT_R8G8B8A8_UNORM;
 
         auto format_properties = VkFormatProperties{};
@@ -92,59 +138,46 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
         assert(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
         assert(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-        auto mem_alloc_info = VkMemoryAllocateInfo{};
-        mem_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        auto mem_reqs = VkMemoryRequirements{};
-
-        auto stage_buffer = VkBuffer{};
-        auto stage_memory = VkDeviceMemory{};
-
-        auto buffer_info = VkBufferCreateInfo{};
-        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        buffer_info.size = buffer_size;
-        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK_RESULT(vkCreateBuffer(device->logical_device, &buffer_info, nullptr, &stage_buffer));
-        vkGetBufferMemoryRequirements(device->logical_device, stage_buffer, &mem_reqs);
-        mem_alloc_info.allocationSize = mem_reqs.size;
-        mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device->logical_device, &mem_alloc_info, nullptr, &stage_memory));
-        VK_CHECK_RESULT(vkBindBufferMemory(device->logical_device, stage_buffer, stage_memory, 0));
-
-        uint8_t* data;
-        VK_CHECK_RESULT(vkMapMemory(device->logical_device, stage_memory, 0, mem_reqs.size, 0, (void**)&data));
-        memcpy(data, buffer, buffer_size);
-        vkUnmapMemory(device->logical_device, stage_memory);
+        // RGB is expanded straight into staging, RGBA copied as is
+        const auto texel_count = static_cast<size_t>(width) * height;
+        auto stage_offset = VkDeviceSize{};
+        auto* data = batch.allocate(texel_count * 4, 16, stage_offset);
+        if(gltf_image.component == 3)
+        {
+            uka::pixel::rgb_to_rgba(&gltf_image.image[0], data, texel_count);
+        }
+        else
+        {
+            memcpy(data, &gltf_image.image[0], texel_count * 4);
+        }
 
-        auto image_info = VkImageCreateInfo{};
-        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        auto image_info = uka::init::image_create_info();
         image_info.imageType = VK_IMAGE_TYPE_2D;
         image_info.format = format;
         image_info.mipLevels = mip_levels;
         image_info.arrayLayers = 1;
         image_info.samples = VK_SAMPLE_COUNT_1_BIT;
         image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-        image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
         image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         image_info.extent = { width, height, 1 };
         image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         VK_CHECK_RESULT(vkCreateImage(device->logical_device, &image_info, nullptr, &image));
+        auto mem_reqs = VkMemoryRequirements{};
         vkGetImageMemoryRequirements(device->logical_device, image, &mem_reqs);
+        auto mem_alloc_info = uka::init::memory_allocate_info();
         mem_alloc_info.allocationSize = mem_reqs.size;
         mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
         VK_CHECK_RESULT(vkAllocateMemory(device->logical_device, &mem_alloc_info, nullptr, &device_memory));
         VK_CHECK_RESULT(vkBindImageMemory(device->logical_device, image, device_memory, 0));
 
-        auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
         auto subresource_range = VkImageSubresourceRange{};
         subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         subresource_range.baseMipLevel = 0;
         subresource_range.levelCount = mip_levels;
+        subresource_range.layerCount = 1;
 
-        auto image_memory_barrier = VkImageMemoryBarrier{};
-        image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        auto image_memory_barrier = uka::init::image_memory_barrier();
         image_memory_barrier.image = image;
         image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -154,98 +187,55 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
         vkCmdPipelineBarrier(copy_cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
 
         auto buffer_image_copy = VkBufferImageCopy{};
+        buffer_image_copy.bufferOffset = stage_offset;
         buffer_image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         buffer_image_copy.imageSubresource.mipLevel = 0;
         buffer_image_copy.imageSubresource.baseArrayLayer = 0;
         buffer_image_copy.imageSubresource.layerCount = 1;
         buffer_image_copy.imageExtent = { width, height, 1 };
-        vkCmdCopyBufferToImage(copy_cmd, stage_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy);
-
-        image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        image_memory_barrier.image = image;
-        image_memory_barrier.subresourceRange = subresource_range;
-        vkCmdPipelineBarrier(copy_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
-
-        device->flush_command_buffer(copy_cmd, copy_queue);
-
-        vkDestroyBuffer(device->logical_device, stage_buffer, nullptr);
-        vkFreeMemory(device->logical_device, stage_memory, nullptr);
-
-        auto blit_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        for(auto i=1;i<mip_levels;i++)
+        vkCmdCopyBufferToImage(copy_cmd, batch.staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy);
+
+        // Each level is blitted from the one above it, which is turned into a transfer source once written
+        auto level_barrier = uka::init::image_memory_barrier();
+        level_barrier.image = image;
+        level_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        level_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        level_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        level_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        level_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(copy_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &level_barrier);
+        for(auto i = uint32_t{1}; i < mip_levels; i++)
         {
             auto image_blit = VkImageBlit{};
             image_blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             image_blit.srcSubresource.layerCount = 1;
             image_blit.srcSubresource.mipLevel = i - 1;
-            image_blit.srcOffsets[1] = { int32_t(width >> (i - 1)), int32_t(height >> (i - 1)), 1 };
+            image_blit.srcOffsets[1] = { int32_t(std::max(width >> (i - 1), 1u)), int32_t(std::max(height >> (i - 1), 1u)), 1 };
             image_blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             image_blit.dstSubresource.layerCount = 1;
             image_blit.dstSubresource.mipLevel = i;
-            image_blit.dstOffsets[1] = { int32_t(width >> i), int32_t(height >> i), 1 };
-
-            auto mip_subresource_range = VkImageSubresourceRange{};
-            mip_subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            mip_subresource_range.baseMipLevel = i;
-            mip_subresource_range.levelCount = 1;
-            mip_subresource_range.layerCount = 1;
-
-            auto image_memory_barrier = VkImageMemoryBarrier{};
-            image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            image_memory_barrier.image = image;
-            image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            image_memory_barrier.srcAccessMask = 0;
-            image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            image_memory_barrier.subresourceRange = mip_subresource_range;
-            vkCmdPipelineBarrier(blit_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
-
-            vkCmdBlitImage(blit_cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_blit, VK_FILTER_LINEAR);
-
-            auto image_memory_barrier2 = VkImageMemoryBarrier{};
-            image_memory_barrier2.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            image_memory_barrier2.image = image;
-            image_memory_barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            image_memory_barrier2.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_memory_barrier2.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            image_memory_barrier2.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            image_memory_barrier2.subresourceRange = mip_subresource_range;
-            vkCmdPipelineBarrier(blit_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier2);
+            image_blit.dstOffsets[1] = { int32_t(std::max(width >> i, 1u)), int32_t(std::max(height >> i, 1u)), 1 };
+            vkCmdBlitImage(copy_cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_blit, VK_FILTER_LINEAR);
 
+            level_barrier.subresourceRange.baseMipLevel = i;
+            vkCmdPipelineBarrier(copy_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &level_barrier);
         }
-        subresource_range.levelCount = mip_levels;
-        image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        image_memory_barrier.image = image;
         image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
         image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
         image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        image_memory_barrier.subresourceRange = subresource_range;
-        vkCmdPipelineBarrier(blit_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
-
-        if(delete_buffer) delete[] buffer;
-
-        device->flush_command_buffer(blit_cmd, copy_queue);
-
+        vkCmdPipelineBarrier(copy_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_memory_barrier);
+        image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
     else
     {
-        auto filename = path + "/" + gltf_image.uri;
-        ktxTexture* ktx_texture;
-        ktxResult result = KTX_SUCCESS;
-        if(!uka::tools::file_exists(filename))
+        if(ktx_image.texture == nullptr)
         {
-            uka::tools::exitFatal("File not found: " + filename,-1);
+            ktx_image = open_ktx(gltf_image, path, device);
         }
-        result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture);
-        assert(result == KTX_SUCCESS);
+        auto* ktx_texture = ktx_image.texture;
 
-        this->device = device;
         width = ktx_texture->baseWidth;
         height = ktx_texture->baseHeight;
         mip_levels = ktx_texture->numLevels;
@@ -253,36 +243,14 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
         auto* ktx_texture_data = ktxTexture_GetData(ktx_texture);
         auto ktx_texture_size = ktxTexture_GetDataSize(ktx_texture);
 
-        format = VK_FORMAT_R8G8B8A8_UNORM;
-        auto format_properties = VkFormatProperties{};
-        vkGetPhysicalDeviceFormatProperties(device->physical_device, format, &format_properties);
-
-        auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        auto mem_alloc_info = uka::init::memory_allocate_info();
-        auto mem_reqs = VkMemoryRequirements();
-        auto stage_buffer = VkBuffer();
-        auto stage_memory = VkDeviceMemory();
-
-        auto buffer_create_info = uka::init::buffer_create_info();
-        buffer_create_info.size = ktx_texture_size;
-        buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK_RESULT(vkCreateBuffer(this->device->logical_device, &buffer_create_info, nullptr, &stage_buffer));
-
-        vkGetBufferMemoryRequirements(this->device->logical_device, stage_buffer, &mem_reqs);
-        mem_alloc_info.allocationSize = mem_reqs.size;
-        mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        VK_CHECK_RESULT(vkAllocateMemory(this->device->logical_device, &mem_alloc_info, nullptr, &stage_memory));
-        VK_CHECK_RESULT(vkBindBufferMemory(this->device->logical_device, stage_buffer, stage_memory, 0));
+        format = ktx_image.format;
 
-        uint8_t* data;
-        VK_CHECK_RESULT(vkMapMemory(this->device->logical_device, stage_memory, 0, mem_alloc_info.allocationSize, 0, (void**)&data));
+        auto stage_offset = VkDeviceSize{};
+        auto* data = batch.allocate(ktx_texture_size, 16, stage_offset);
         memcpy(data, ktx_texture_data, ktx_texture_size);
-        vkUnmapMemory(this->device->logical_device, stage_memory);
 
         auto buffer_copy_regions = std::vector<VkBufferImageCopy>();
-        for(auto i=0;i<mip_levels;i++)
+        for(auto i = uint32_t{0}; i < mip_levels; i++)
         {
             auto offset = ktx_size_t {};
             auto result = ktxTexture_GetImageOffset(ktx_texture, i, 0, 0, &offset);
@@ -295,9 +263,10 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
             buffer_image_copy.imageExtent.width = std::max(1u, ktx_texture->baseWidth >> i);
             buffer_image_copy.imageExtent.height = std::max(1u, ktx_texture->baseHeight >> i);
             buffer_image_copy.imageExtent.depth = 1;
-            buffer_image_copy.bufferOffset = offset;
+            buffer_image_copy.bufferOffset = stage_offset + offset;
             buffer_copy_regions.push_back(buffer_image_copy);
         }
+        ktxTexture_Destroy(ktx_texture);
 
         auto image_create_info = uka::init::image_create_info();
         image_create_info.imageType = VK_IMAGE_TYPE_2D;
@@ -310,17 +279,17 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
         image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         image_create_info.arrayLayers = 1;
         image_create_info.mipLevels = mip_levels;
-        image_create_info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
         VK_CHECK_RESULT(vkCreateImage(this->device->logical_device, &image_create_info, nullptr, &image));
 
+        auto mem_reqs = VkMemoryRequirements();
         vkGetImageMemoryRequirements(this->device->logical_device, image, &mem_reqs);
+        auto mem_alloc_info = uka::init::memory_allocate_info();
         mem_alloc_info.allocationSize = mem_reqs.size;
         mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         VK_CHECK_RESULT(vkAllocateMemory(this->device->logical_device, &mem_alloc_info, nullptr, &device_memory));
         VK_CHECK_RESULT(vkBindImageMemory(this->device->logical_device, image, device_memory, 0));
 
-
         auto image_subresource_range = VkImageSubresourceRange();
         image_subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         image_subresource_range.baseMipLevel = 0;
@@ -328,16 +297,89 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
         image_subresource_range.layerCount = 1;
 
         uka::tools::set_image_layout(copy_cmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_subresource_range);
-        vkCmdCopyBufferToImage(copy_cmd, stage_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copy_regions.size(), buffer_copy_regions.data());
+        vkCmdCopyBufferToImage(copy_cmd, batch.staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(buffer_copy_regions.size()), buffer_copy_regions.data());
         uka::tools::set_image_layout(copy_cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, image_subresource_range);
-        device->flush_command_buffer(copy_cmd, copy_queue);
         this->image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
 
-        vkDestroyBuffer(this->device->logical_device, stage_buffer, nullptr);
-        vkFreeMemory(this->device->logical_device, stage_memory, nullptr);
-        ktxTexture_Destroy(ktx_texture);
+    this->format = format;
+    resident_level = 0;
+    create_sampler();
+    create_view();
+}
+
+auto uka::gltf::Texture::from_levels(const uint8_t* data,
+    const size_t* level_offsets,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    uint32_t mip_levels,
+    uint32_t resident_level,
+    uka::Uka_Device* device,
+    Uka_Upload_Batch& batch) -> void
+{
+    this->device = device;
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    this->mip_levels = mip_levels;
+    this->resident_level = resident_level;
+    layer_count = 1;
+
+    auto image_create_info = uka::init::image_create_info();
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = format;
+    image_create_info.extent = {width, height, 1};
+    image_create_info.mipLevels = mip_levels;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Streamed levels are written by the transfer queue family while the graphics family samples the others
+    const uint32_t queue_families[2] = {device->queue_family_indices.graphics, device->queue_family_indices.transfer};
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(queue_families[0] != queue_families[1])
+    {
+        image_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        image_create_info.queueFamilyIndexCount = 2;
+        image_create_info.pQueueFamilyIndices = queue_families;
+    }
+    VK_CHECK_RESULT(vkCreateImage(device->logical_device, &image_create_info, nullptr, &image));
+
+    auto mem_reqs = VkMemoryRequirements{};
+    vkGetImageMemoryRequirements(device->logical_device, image, &mem_reqs);
+    auto mem_alloc_info = uka::init::memory_allocate_info();
+    mem_alloc_info.allocationSize = mem_reqs.size;
+    mem_alloc_info.memoryTypeIndex = device->get_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(device->logical_device, &mem_alloc_info, nullptr, &device_memory));
+    VK_CHECK_RESULT(vkBindImageMemory(device->logical_device, image, device_memory, 0));
+
+    auto buffer_copy_regions = std::vector<VkBufferImageCopy>();
+    for(auto level = resident_level; level < mip_levels; level++)
+    {
+        const auto level_size = level_offsets[level + 1] - level_offsets[level];
+        auto stage_offset = VkDeviceSize{};
+        memcpy(batch.allocate(level_size, 16, stage_offset), data + level_offsets[level], level_size);
+        auto buffer_image_copy = VkBufferImageCopy{};
+        buffer_image_copy.bufferOffset = stage_offset;
+        buffer_image_copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        buffer_image_copy.imageExtent = {std::max(1u, width >> level), std::max(1u, height >> level), 1};
+        buffer_copy_regions.push_back(buffer_image_copy);
     }
 
+    const auto resident_range = VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, resident_level, mip_levels - resident_level, 0, 1};
+    uka::tools::set_image_layout(batch.command_buffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, resident_range);
+    vkCmdCopyBufferToImage(batch.command_buffer, batch.staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(buffer_copy_regions.size()), buffer_copy_regions.data());
+    uka::tools::set_image_layout(batch.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, resident_range);
+    image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    create_sampler();
+    create_view();
+}
+
+auto uka::gltf::Texture::create_sampler() -> void
+{
     auto sampler_create_info = VkSamplerCreateInfo();
     sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     sampler_create_info.magFilter = VK_FILTER_LINEAR;
@@ -346,29 +388,29 @@ auto uka::gltf::Texture::from_gltf_image(const tinygltf::Image& gltf_image,
     sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
     sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
     sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-    sampler_create_info.maxAnisotropy = 1.0;
-    sampler_create_info.anisotropyEnable = VK_FALSE;
     sampler_create_info.maxAnisotropy = 8.0f;
     sampler_create_info.anisotropyEnable = VK_TRUE;
     sampler_create_info.compareOp = VK_COMPARE_OP_NEVER;
-    sampler_create_info.minLod = mip_levels;
+    // The view limits sampling to the resident levels, the sampler does not clamp further
+    sampler_create_info.minLod = 0.0f;
+    sampler_create_info.maxLod = static_cast<float>(mip_levels);
     sampler_create_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
     VK_CHECK_RESULT(vkCreateSampler(device->logical_device, &sampler_create_info, nullptr, &sampler));
+}
 
-    auto image_view_create_info = VkImageViewCreateInfo();
+auto uka::gltf::Texture::create_view() -> void
+{
+    auto image_view_create_info = uka::init::image_view_create_info();
     image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
     image_view_create_info.format = format;
-    image_view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-    image_view_create_info.subresourceRange.levelCount = mip_levels;
-    image_view_create_info.subresourceRange.layerCount = 1;
+    image_view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, resident_level, mip_levels - resident_level, 0, 1};
     image_view_create_info.image = image;
     VK_CHECK_RESULT(vkCreateImageView(device->logical_device, &image_view_create_info, nullptr, &image_view));
 
     descriptor.sampler = sampler;
     descriptor.imageView = image_view;
     descriptor.imageLayout = image_layout;
-
 }
 
 auto uka::gltf::Material::create_descriptor_set(VkDescriptorPool descriptor_pool,
@@ -378,39 +420,39 @@ auto uka::gltf::Material::create_descriptor_set(VkDescriptorPool descriptor_pool
     auto descriptor_set_alloc_info = VkDescriptorSetAllocateInfo{};
     descriptor_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descriptor_set_alloc_info.descriptorPool = descriptor_pool;
+    descriptor_set_alloc_info.pSetLayouts = &descriptor_set_layout;
     descriptor_set_alloc_info.descriptorSetCount = 1;
     VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &descriptor_set_alloc_info, &descriptor_set));
+    update_descriptor_set(descriptor_binding_flags);
+}
+
+auto uka::gltf::Material::update_descriptor_set(uint32_t descriptor_binding_flags) -> void
+{
     auto image_desciptors = std::vector<VkDescriptorImageInfo>();
+    // Writes point into image_desciptors, it must not reallocate
+    image_desciptors.reserve(2);
     auto write_descriptor_infos = std::vector<VkWriteDescriptorSet>();
     if(descriptor_binding_flags & uka::gltf::DescriptorBindingFlags::image_base_color)
     {
-        auto image_descriptor = VkDescriptorImageInfo{};
-        image_descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_descriptor.imageView = base_color_texture->image_view;
-        image_descriptor.sampler = base_color_texture->sampler;
-        image_desciptors.push_back(image_descriptor);
+        image_desciptors.push_back(base_color_texture->descriptor);
         auto write_descriptor_info = VkWriteDescriptorSet{};
         write_descriptor_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write_descriptor_info.dstSet = descriptor_set;
         write_descriptor_info.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         write_descriptor_info.dstBinding = 0;
-        write_descriptor_info.pImageInfo = &image_descriptor;
+        write_descriptor_info.pImageInfo = &image_desciptors.back();
         write_descriptor_info.descriptorCount = 1;
         write_descriptor_infos.push_back(write_descriptor_info);
     }
     if(normal_texture && descriptor_binding_flags & uka::gltf::DescriptorBindingFlags::image_normal_map)
     {
-        auto image_descriptor = VkDescriptorImageInfo{};
-        image_descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_descriptor.imageView = normal_texture->image_view;
-        image_descriptor.sampler = normal_texture->sampler;
-        image_desciptors.push_back(image_descriptor);
+        image_desciptors.push_back(normal_texture->descriptor);
         auto write_descriptor_info = VkWriteDescriptorSet{};
         write_descriptor_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write_descriptor_info.dstSet = descriptor_set;
         write_descriptor_info.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         write_descriptor_info.dstBinding = 1;
-        write_descriptor_info.pImageInfo = &image_descriptor;
+        write_descriptor_info.pImageInfo = &image_desciptors.back();
         write_descriptor_info.descriptorCount = 1;
         write_descriptor_infos.push_back(write_descriptor_info);
     }
@@ -426,23 +468,6 @@ auto uka::gltf::Primitive::set_dimensions(const glm::vec3& min, const glm::vec3&
     dimensions.radius = glm::distance(min, max) / 2.0f;
 }
 
-uka::gltf::Mesh::Mesh(Uka_Device* device,glm::mat4 matrix)
-{
-    this->device = device;
-    this->uniform_block.matrix = matrix;
-    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(uniform_block), &uniform_buffer.buffer, &uniform_buffer.memory, &uniform_block));
-    VK_CHECK_RESULT(vkMapMemory(device->logical_device, uniform_buffer.memory, 0, sizeof(uniform_block), 0, &uniform_buffer.mapped));
-    uniform_buffer.descriptor = {uniform_buffer.buffer, 0, sizeof(uniform_block)};
-}
-uka::gltf::Mesh::~Mesh()
-{
-    vkDestroyBuffer(device->logical_device, uniform_buffer.buffer, nullptr);
-    vkFreeMemory(device->logical_device, uniform_buffer.memory, nullptr);
-    for(auto primitive : primitives)
-    {
-        delete primitive;
-    }
-}
 
 auto uka::gltf::Node::local_matrix_from_node() -> glm::mat4
 {
@@ -461,92 +486,133 @@ auto uka::gltf::Node::get_matrix() -> glm::mat4
     return m;
 }
 
-auto uka::gltf::Node::update() -> void
+auto uka::gltf::Node::mark_dirty() -> void
 {
-    if(mesh)
+    dirty = true;
+    for(auto* p = parent; p && !p->subtree_dirty; p = p->parent)
     {
-        auto m = get_matrix();
-        if(skin)
-        {
-            mesh->uniform_block.matrix = m;
-            for(auto i=0;i<skin->joints.size();i++)
-            {
-                mesh->uniform_block.joint_matrix[i] = glm::inverse(m) * skin->joints[i]->get_matrix() * skin->inverse_bind_matrices[i];
-            }
-            mesh->uniform_block.joint_count = skin->joints.size();
-            memcpy(mesh->uniform_buffer.mapped, &mesh->uniform_block, sizeof(mesh->uniform_block));
-        }
-        else
+        p->subtree_dirty = true;
+    }
+}
+
+auto uka::gltf::Node::update_mesh_transform(MeshTransform& transform, glm::mat4* joint_matrices) -> void
+{
+    transform.matrix = world_matrix;
+    if(skin)
+    {
+        const auto inverse_world = glm::inverse(world_matrix);
+        for(auto i=0;i<skin->joints.size();i++)
         {
-            memcpy(mesh->uniform_buffer.mapped, &m, sizeof(m));
+            joint_matrices[i] = inverse_world * skin->joints[i]->world_matrix * skin->inverse_bind_matrices[i];
         }
     }
-    for(auto child : children)
+}
+
+static VkVertexInputBindingDescription vertex_input_binding_description;
+static std::vector<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions;
+static VkPipelineVertexInputStateCreateInfo pipeline_vertex_input_state_create_info;
+
+auto uka::gltf::Vertex::stream_of(VertexComponent component) -> uint32_t
+{
+    switch(component)
     {
-        child->update();
+        case VertexComponent::POSITION:
+            return 0;
+        case VertexComponent::JOINTS:
+        case VertexComponent::WEIGHTS:
+            return 2;
+        default:
+            return 1;
     }
 }
 
-uka::gltf::Node::~Node()
+auto uka::gltf::Vertex::layout(uint32_t compression, bool split_streams) -> VertexLayout
 {
-    if(mesh)
+    auto result = VertexLayout{};
+    result.formats[VertexComponent::POSITION] = VK_FORMAT_R32G32B32_SFLOAT;
+    result.formats[VertexComponent::NORMAL] = VK_FORMAT_R32G32B32_SFLOAT;
+    result.formats[VertexComponent::UV] = VK_FORMAT_R32G32_SFLOAT;
+    result.formats[VertexComponent::COLOR] = VK_FORMAT_R32G32B32A32_SFLOAT;
+    result.formats[VertexComponent::TANGENT] = VK_FORMAT_R32G32B32_SFLOAT;
+    result.formats[VertexComponent::JOINTS] = VK_FORMAT_R32G32B32A32_SFLOAT;
+    result.formats[VertexComponent::WEIGHTS] = VK_FORMAT_R32G32B32A32_SFLOAT;
+    if(compression == COMPRESS_NONE && !split_streams)
+    {
+        result.stride = sizeof(Vertex);
+        result.stream_strides[0] = sizeof(Vertex);
+        result.offsets[VertexComponent::POSITION] = offsetof(Vertex, position);
+        result.offsets[VertexComponent::NORMAL] = offsetof(Vertex, normal);
+        result.offsets[VertexComponent::UV] = offsetof(Vertex, uv);
+        result.offsets[VertexComponent::COLOR] = offsetof(Vertex, color);
+        result.offsets[VertexComponent::TANGENT] = offsetof(Vertex, tangent);
+        result.offsets[VertexComponent::JOINTS] = offsetof(Vertex, joints_0);
+        result.offsets[VertexComponent::WEIGHTS] = offsetof(Vertex, weights_0);
+        return result;
+    }
+
+    // Scaled/normalized formats keep the shader inputs float, only octahedral normals and positions need decoding
+    uint32_t sizes[7] = {12, 12, 8, 16, 16, 16, 16};
+    if(compression & COMPRESS_POSITION_UNORM16)
     {
-        delete mesh;
+        result.formats[VertexComponent::POSITION] = VK_FORMAT_R16G16B16A16_UNORM;
+        sizes[VertexComponent::POSITION] = 8;
     }
-    for(auto child : children)
+    if(compression & COMPRESS_NORMAL_OCTAHEDRAL)
     {
-        delete child;
+        result.formats[VertexComponent::NORMAL] = VK_FORMAT_R16G16_SNORM;
+        result.formats[VertexComponent::TANGENT] = VK_FORMAT_R8G8B8A8_SNORM;
+        sizes[VertexComponent::NORMAL] = 4;
+        sizes[VertexComponent::TANGENT] = 4;
     }
+    if(compression & COMPRESS_UV_HALF)
+    {
+        result.formats[VertexComponent::UV] = VK_FORMAT_R16G16_SFLOAT;
+        sizes[VertexComponent::UV] = 4;
+    }
+    if(compression & COMPRESS_COLOR_UNORM8)
+    {
+        result.formats[VertexComponent::COLOR] = VK_FORMAT_R8G8B8A8_UNORM;
+        result.formats[VertexComponent::WEIGHTS] = VK_FORMAT_R8G8B8A8_UNORM;
+        sizes[VertexComponent::COLOR] = 4;
+        sizes[VertexComponent::WEIGHTS] = 4;
+    }
+    if(compression & COMPRESS_JOINTS_UINT8)
+    {
+        result.formats[VertexComponent::JOINTS] = VK_FORMAT_R8G8B8A8_USCALED;
+        sizes[VertexComponent::JOINTS] = 4;
+    }
+    else if(compression & COMPRESS_JOINTS_UINT16)
+    {
+        result.formats[VertexComponent::JOINTS] = VK_FORMAT_R16G16B16A16_USCALED;
+        sizes[VertexComponent::JOINTS] = 8;
+    }
+    result.stride = 0;
+    for(auto i = 0; i < 7; i++)
+    {
+        auto stream = split_streams ? stream_of(static_cast<VertexComponent>(i)) : 0;
+        result.streams[i] = stream;
+        result.offsets[i] = result.stream_strides[stream];
+        result.stream_strides[stream] += sizes[i];
+        result.stride += sizes[i];
+    }
+    return result;
 }
 
-static VkVertexInputBindingDescription vertex_input_binding_description;
-static std::vector<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions;
-static VkPipelineVertexInputStateCreateInfo pipeline_vertex_input_state_create_info;
-
 auto uka::gltf::Vertex::input_binding_description(uint32_t biding) -> VkVertexInputBindingDescription
 {
-    return VkVertexInputBindingDescription{biding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX};
+    return VkVertexInputBindingDescription{biding, layout().stride, VK_VERTEX_INPUT_RATE_VERTEX};
 }
 
 auto uka::gltf::Vertex::input_attribute_description(uint32_t binding,
     uint32_t location,
     uka::gltf::VertexComponent component) -> VkVertexInputAttributeDescription
 {
-    switch (component)
+    if(component < VertexComponent::POSITION || component > VertexComponent::WEIGHTS)
     {
-        case uka::gltf::VertexComponent::POSITION:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32_SFLOAT,offsetof(Vertex, position) };
-        }
-        case uka::gltf::VertexComponent::NORMAL:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32_SFLOAT,offsetof(Vertex, normal) };
-        }
-        case uka::gltf::VertexComponent::UV:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32_SFLOAT,offsetof(Vertex, uv) };
-        }
-        case uka::gltf::VertexComponent::COLOR:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT,offsetof(Vertex, color) };
-        }
-        case uka::gltf::VertexComponent::TANGENT:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32_SFLOAT,offsetof(Vertex, tangent) };
-        }
-        case uka::gltf::VertexComponent::JOINTS:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT,offsetof(Vertex, joints_0) };
-        }
-        case uka::gltf::VertexComponent::WEIGHTS:
-        {
-            return VkVertexInputAttributeDescription{ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT,offgiitsetof(Vertex, weights_0) };
-        }
-        default:
-        {
-            return VkVertexInputAttributeDescription{};
-        }
+        return VkVertexInputAttributeDescription{};
     }
+    const auto vertex_layout = layout();
+    return VkVertexInputAttributeDescription{ location, binding, vertex_layout.formats[component], vertex_layout.offsets[component] };
 }
 
 auto uka::gltf::Vertex::input_attribute_descriptions(uint32_t binding,const std::vector<uka::gltf::VertexComponent> components) -> std::vector<VkVertexInputAttributeDescription>
@@ -572,6 +638,36 @@ auto uka::gltf::Vertex::pipeline_vertex_input_state(const std::vector<uka::gltf:
     return &pipeline_vertex_input_state_create_info;
 }
 
+static std::vector<VkVertexInputBindingDescription> vertex_input_binding_descriptions_split;
+
+auto uka::gltf::Vertex::pipeline_vertex_input_state_split(const std::vector<uka::gltf::VertexComponent> components) -> VkPipelineVertexInputStateCreateInfo*
+{
+    const auto vertex_layout = layout(vertex_compression, true);
+    vertex_input_binding_descriptions_split.clear();
+    vertex_input_attribute_descriptions.clear();
+    auto used_streams = uint32_t{0};
+    for(auto i = uint32_t{0}; i < components.size(); i++)
+    {
+        auto stream = vertex_layout.streams[components[i]];
+        vertex_input_attribute_descriptions.push_back(VkVertexInputAttributeDescription{ i, stream, vertex_layout.formats[components[i]], vertex_layout.offsets[components[i]] });
+        used_streams |= 1u << stream;
+    }
+    for(auto stream = uint32_t{0}; stream < 3; stream++)
+    {
+        if(used_streams & (1u << stream))
+        {
+            vertex_input_binding_descriptions_split.push_back(VkVertexInputBindingDescription{stream, vertex_layout.stream_strides[stream], VK_VERTEX_INPUT_RATE_VERTEX});
+        }
+    }
+    pipeline_vertex_input_state_create_info = VkPipelineVertexInputStateCreateInfo{};
+    pipeline_vertex_input_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    pipeline_vertex_input_state_create_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_binding_descriptions_split.size());
+    pipeline_vertex_input_state_create_info.pVertexBindingDescriptions = vertex_input_binding_descriptions_split.data();
+    pipeline_vertex_input_state_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_attribute_descriptions.size());
+    pipeline_vertex_input_state_create_info.pVertexAttributeDescriptions = vertex_input_attribute_descriptions.data();
+    return &pipeline_vertex_input_state_create_info;
+}
+
 auto uka::gltf::Model::get_texture(uint32_t index) -> Texture*
 {
     if(index < textures.size())
@@ -690,26 +786,82 @@ uka::gltf::Model::~Model()
     vkFreeMemory(device->logical_device, vertices.memory, nullptr);
     vkDestroyBuffer(device->logical_device, indices.buffer, nullptr);
     vkFreeMemory(device->logical_device, indices.memory, nullptr);
+    // A pending streaming copy still writes the images
+    texture_streaming.batch.reset();
+    if(texture_streaming.command_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(device->logical_device, texture_streaming.command_pool, nullptr);
+    }
+    // Retired material sets go with descriptor_pool
+    for(const auto& retired : texture_streaming.retired)
+    {
+        if(retired.image_view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device->logical_device, retired.image_view, nullptr);
+        }
+    }
     for(auto& texture : textures)
     {
         texture.destroy();
     }
-    for(auto& node : nodes)
+    scene_arena.reset();
+    if(skinning.pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(device->logical_device, skinning.pipeline, nullptr);
+        vkDestroyPipelineLayout(device->logical_device, skinning.pipeline_layout, nullptr);
+        vkDestroyDescriptorPool(device->logical_device, skinning.descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(device->logical_device, skinning.descriptor_set_layout, nullptr);
+    }
+    if(skinning.output != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device->logical_device, skinning.output, nullptr);
+        vkFreeMemory(device->logical_device, skinning.output_memory, nullptr);
+    }
+    if(transforms.buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device->logical_device, transforms.buffer, nullptr);
+        vkFreeMemory(device->logical_device, transforms.memory, nullptr);
+    }
+    if(indirect.buffer != VK_NULL_HANDLE)
     {
-        delete node;
+        vkDestroyBuffer(device->logical_device, indirect.buffer, nullptr);
+        vkFreeMemory(device->logical_device, indirect.memory, nullptr);
     }
-    for(auto& skin : skins)
+    if(gpu_culling.pipeline != VK_NULL_HANDLE)
     {
-        delete skin;
+        vkDestroyPipeline(device->logical_device, gpu_culling.pipeline, nullptr);
+        vkDestroyPipeline(device->logical_device, gpu_culling.occlusion_pipeline, nullptr);
+        vkDestroyPipelineLayout(device->logical_device, gpu_culling.pipeline_layout, nullptr);
+        vkDestroyDescriptorPool(device->logical_device, gpu_culling.descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(device->logical_device, gpu_culling.descriptor_set_layout, nullptr);
+        vkDestroyDescriptorSetLayout(device->logical_device, gpu_culling.occlusion_set_layout, nullptr);
+        vkDestroyBuffer(device->logical_device, gpu_culling.occlusion_buffer, nullptr);
+        vkFreeMemory(device->logical_device, gpu_culling.occlusion_memory, nullptr);
+        vkDestroyBuffer(device->logical_device, gpu_culling.records, nullptr);
+        vkFreeMemory(device->logical_device, gpu_culling.records_memory, nullptr);
+        vkDestroyBuffer(device->logical_device, gpu_culling.output, nullptr);
+        vkFreeMemory(device->logical_device, gpu_culling.output_memory, nullptr);
     }
-    if(descriptor_set_layout_ubo != VK_NULL_HANDLE)
+    if(descriptor_set_layout_transforms != VK_NULL_HANDLE)
     {
-        vkDestroyDescriptorSetLayout(device->logical_device, descriptor_set_layout_ubo, nullptr);
+        vkDestroyDescriptorSetLayout(device->logical_device, descriptor_set_layout_transforms, nullptr);
+        descriptor_set_layout_transforms = VK_NULL_HANDLE;
     }
     if(descriptor_set_layout_image != VK_NULL_HANDLE)
     {
         vkDestroyDescriptorSetLayout(device->logical_device, descriptor_set_layout_image, nullptr);
     }
+    if(descriptor_set_layout_bindless != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(device->logical_device, descriptor_set_layout_bindless, nullptr);
+        descriptor_set_layout_bindless = VK_NULL_HANDLE;
+    }
+    if(bindless.materials != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device->logical_device, bindless.materials, nullptr);
+        vkFreeMemory(device->logical_device, bindless.memory, nullptr);
+        vkDestroyDescriptorPool(device->logical_device, bindless.descriptor_pool, nullptr);
+    }
     vkDestroyDescriptorPool(device->logical_device, descriptor_pool, nullptr);
     empty_texture.destroy();
 }
@@ -718,12 +870,19 @@ auto uka::gltf::Model::load_node(uka::gltf::Node* parent,
     const tinygltf::Node& node,
     uint32_t node_index,
     const tinygltf::Model& model,
-    std::vector<uint32_t>& index_buffer,
-    std::vector<Vertex>& vertex_buffer,
+    std::vector<PrimitiveLoadJob>& primitive_jobs,
+    uint32_t& vertex_count,
+    uint32_t& index_count,
     float global_scale) -> void
 {
-    auto *newnode = new uka::gltf::Node();
+    auto *newnode = scene_arena.create<uka::gltf::Node>();
     newnode->index = node_index;
+    newnode->linear_index = static_cast<uint32_t>(linear_nodes.size());
+    linear_nodes.push_back(newnode);
+    if(!node_lookup[node_index])
+    {
+        node_lookup[node_index] = newnode;
+    }
     newnode->parent = parent;
     newnode->name = node.name;
     newnode->skin_index = node.skin;
@@ -752,13 +911,13 @@ auto uka::gltf::Model::load_node(uka::gltf::Node* parent,
     {
         for(auto childIndex : node.children)
         {
-            load_node(newnode, model.nodes[childIndex], childIndex, model, index_buffer, vertex_buffer, global_scale);
+            load_node(newnode, model.nodes[childIndex], childIndex, model, primitive_jobs, vertex_count, index_count, global_scale);
         }
     }
     if(node.mesh >-1)
     {
-        const auto mesh = model.meshes[node.mesh];
-        auto newmesh = new uka::gltf::Mesh(device,newnode->matrix);
+        const auto& mesh = model.meshes[node.mesh];
+        auto newmesh = scene_arena.create<uka::gltf::Mesh>();
         newmesh->name = mesh.name;
         for(auto j=0;j<mesh.primitives.size();j++)
         {
@@ -767,204 +926,401 @@ auto uka::gltf::Model::load_node(uka::gltf::Node* parent,
             {
                 continue;
             }
-            auto indexStart = static_cast<uint32_t>(index_buffer.size());
-            auto vertexStart = static_cast<uint32_t>(vertex_buffer.size());
-            auto indexCount = 0;
-            auto vertexCount = 0;
-            auto pos_min = glm::vec3(std::numeric_limits<float>::max());
-            auto pos_max = glm::vec3(-std::numeric_limits<float>::max());
-            bool has_skin = false;
-
-            //Vertices
+            assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+
+            // Offsets come from the accessor counts so every primitive can be decoded independently later
+            const auto& pos_accessor = model.accessors[primitive.attributes.find("POSITION")->second];
+            const auto& index_accessor = model.accessors[primitive.indices];
+            auto pos_max = glm::vec3(pos_accessor.maxValues[0], pos_accessor.maxValues[1], pos_accessor.maxValues[2]);
+            auto pos_min = glm::vec3(pos_accessor.minValues[0], pos_accessor.minValues[1], pos_accessor.minValues[2]);
+
+            auto material_index = primitive.material > -1 ? static_cast<uint32_t>(primitive.material) : static_cast<uint32_t>(materials.size() - 1);
+            auto new_primitive = scene_arena.create<Primitive>(index_count, static_cast<uint32_t>(index_accessor.count), materials[material_index]);
+            new_primitive->material_index = material_index;
+            new_primitive->first_vertex = vertex_count;
+            new_primitive->vertex_count = static_cast<uint32_t>(pos_accessor.count);
+            new_primitive->set_dimensions(pos_min, pos_max);
+            vertex_count += new_primitive->vertex_count;
+            index_count += new_primitive->index_count;
+
+            primitive_jobs.push_back({&primitive, new_primitive});
+            newmesh->primitives.push_back(new_primitive);
+        }
+        newnode->mesh = newmesh;
+    }
+
+
+    if(parent){
+        parent->children.push_back(newnode);
+    }
+    else
+    {
+        nodes.push_back(newnode);
+    }
+
+}
+
+auto uka::gltf::Model::accessor_data(const tinygltf::Model& model, const tinygltf::Accessor& accessor) const -> const unsigned char*
+{
+    const auto& view = model.bufferViews[accessor.bufferView];
+    return buffer_data[view.buffer] + view.byteOffset + accessor.byteOffset;
+}
+
+auto uka::gltf::Model::attribute_data(const tinygltf::Model& model,
+    const tinygltf::Primitive& primitive,
+    const char* name,
+    size_t& stride,
+    const tinygltf::Accessor** accessor_out) const -> const unsigned char*
+{
+    auto attribute = primitive.attributes.find(name);
+    if(attribute == primitive.attributes.end())
+    {
+        return nullptr;
+    }
+    const auto& accessor = model.accessors[attribute->second];
+    const auto byte_stride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+    if(byte_stride < 0)
+    {
+        throw std::runtime_error(std::string("Invalid buffer view for attribute ") + name);
+    }
+    stride = static_cast<size_t>(byte_stride);
+    if(accessor_out)
+    {
+        *accessor_out = &accessor;
+    }
+    return accessor_data(model, accessor);
+}
+
+auto uka::gltf::Model::load_primitive(const tinygltf::Model& model,
+    const PrimitiveLoadJob& job,
+    std::vector<uint32_t>& index_buffer,
+    std::vector<Vertex>& vertex_buffer) -> void
+{
+    const auto& primitive = *job.source;
+    const auto vertex_start = job.primitive->first_vertex;
+    const auto index_start = job.primitive->first_index;
+
+    //Vertices
+    {
+        auto pos_stride = size_t{0};
+        auto normal_stride = size_t{0};
+        auto tangent_stride = size_t{0};
+        auto texcoord_stride = size_t{0};
+        auto color_stride = size_t{0};
+        auto joint_stride = size_t{0};
+        auto weight_stride = size_t{0};
+        const tinygltf::Accessor* color_accessor = nullptr;
+        const tinygltf::Accessor* joint_accessor = nullptr;
+
+        auto buffer_pos = attribute_data(model, primitive, "POSITION", pos_stride);
+        auto buffer_normals = attribute_data(model, primitive, "NORMAL", normal_stride);
+        auto buffer_tangents = attribute_data(model, primitive, "TANGENT", tangent_stride);
+        auto buffer_texcoords = attribute_data(model, primitive, "TEXCOORD_0", texcoord_stride);
+        auto buffer_colors = attribute_data(model, primitive, "COLOR_0", color_stride, &color_accessor);
+        auto buffer_joints = attribute_data(model, primitive, "JOINTS_0", joint_stride, &joint_accessor);
+        auto buffer_weights = attribute_data(model, primitive, "WEIGHTS_0", weight_stride);
+        auto has_skin = (buffer_joints && buffer_weights);
+        auto num_color_component = color_accessor ? color_accessor->type : 0;
+
+        for (auto v = size_t{0}; v < job.primitive->vertex_count; v++)
+        {
+            auto& vert = vertex_buffer[vertex_start + v];
+            vert.position = glm::make_vec3(reinterpret_cast<const float*>(buffer_pos + v * pos_stride));
+            vert.normal =
+                glm::normalize(glm::vec3(buffer_normals ? glm::make_vec3(reinterpret_cast<const float*>(buffer_normals + v * normal_stride)) : glm::vec3(
+                    0.0f)));
+            vert.uv = buffer_texcoords ? glm::make_vec2(reinterpret_cast<const float*>(buffer_texcoords + v * texcoord_stride)) : glm::vec2(0.0f);
+            if (buffer_colors)
             {
-                const float* buffer_pos = nullptr;
-                const float* buffer_normals = nullptr;
-                const float* buffer_tangents = nullptr;
-                const float* buffer_texcoords = nullptr;
-                const float* buffer_colors = nullptr;
-                const uint16_t* buffer_joints = nullptr;
-                const float* buffer_weights = nullptr;
-                uint32_t num_color_component;
-
-                assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-                auto pos_accessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                auto pos_view = model.bufferViews[pos_accessor.bufferView];
-                buffer_pos =
-                    reinterpret_cast<const float*>(&(model.buffers[pos_view.buffer].data[pos_accessor.byteOffset
-                        + pos_view.byteOffset]));
-                pos_max = glm::vec3(pos_accessor.maxValues[0], pos_accessor.maxValues[1], pos_accessor.maxValues[2]);
-                pos_min = glm::vec3(pos_accessor.minValues[0], pos_accessor.minValues[1], pos_accessor.minValues[2]);
-
-                if (primitive.attributes.find("NORMAL") != primitive.attributes.end())
-                {
-                    auto normals_accessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                    auto normals_view = model.bufferViews[normals_accessor.bufferView];
-                    buffer_normals = reinterpret_cast<const float*>(&(model.buffers[normals_view.buffer].data[
-                        normals_accessor.byteOffset + normals_view.byteOffset]));
-                }
-                if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-                {
-                    auto tangents_accessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-                    auto tangents_view = model.bufferViews[tangents_accessor.bufferView];
-                    buffer_tangents = reinterpret_cast<const float*>(&(model.buffers[tangents_view.buffer].data[
-                        tangents_accessor.byteOffset + tangents_view.byteOffset]));
-                }
-                if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end())
+                auto color = reinterpret_cast<const float*>(buffer_colors + v * color_stride);
+                switch (num_color_component)
                 {
-                    auto texcoords_accessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                    auto texcoords_view = model.bufferViews[texcoords_accessor.bufferView];
-                    buffer_texcoords = reinterpret_cast<const float*>(&(model.buffers[texcoords_view.buffer].data[
-                        texcoords_accessor.byteOffset + texcoords_view.byteOffset]));
+                case 3:
+                    vert.color = glm::vec4(glm::make_vec3(color), 1.0f);
+                    break;
+                case 4:
+                    vert.color = glm::make_vec4(color);
+                    break;
+                default:
+                    vert.color = glm::vec4(1.0f);
+
                 }
-                if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
+            }
+            else
+            {
+                vert.color = glm::vec4(1.0f);
+            }
+            vert.tangent =
+                buffer_tangents ? glm::vec4(glm::make_vec3(reinterpret_cast<const float*>(buffer_tangents + v * tangent_stride)), 1.0f) : glm::vec4(0.0f);
+            if (has_skin)
+            {
+                if (joint_accessor->componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE)
                 {
-                    auto colors_accessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-                    auto colors_view = model.bufferViews[colors_accessor.bufferView];
-                    buffer_colors = reinterpret_cast<const float*>(&(model.buffers[colors_view.buffer].data[
-                        colors_accessor.byteOffset + colors_view.byteOffset]));
-                    num_color_component = colors_accessor.type;
+                    auto joints = buffer_joints + v * joint_stride;
+                    vert.joints_0 = glm::vec4(joints[0], joints[1], joints[2], joints[3]);
                 }
-                if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end())
+                else
                 {
-                    auto joints_accessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-                    auto joints_view = model.bufferViews[joints_accessor.bufferView];
-                    buffer_joints = reinterpret_cast<const uint16_t*>(&(model.buffers[joints_view.buffer].data[
-                        joints_accessor.byteOffset + joints_view.byteOffset]));
-                    has_skin = true;
+                    auto joints = reinterpret_cast<const uint16_t*>(buffer_joints + v * joint_stride);
+                    vert.joints_0 = glm::vec4(joints[0], joints[1], joints[2], joints[3]);
                 }
-                if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end())
+                vert.weights_0 = glm::make_vec4(reinterpret_cast<const float*>(buffer_weights + v * weight_stride));
+            }
+            else
+            {
+                vert.joints_0 = glm::vec4(0.0f);
+                vert.weights_0 = glm::vec4(0.0f);
+            }
+        }
+    }
+    // Indices
+    {
+        const auto& index_accessor = model.accessors[primitive.indices];
+        const auto* index_data = accessor_data(model, index_accessor);
+        switch(index_accessor.componentType)
+        {
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+            {
+                auto buf = reinterpret_cast<const uint32_t*>(index_data);
+                for(auto i=size_t{0};i<index_accessor.count;i++)
                 {
-                    auto weights_accessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-                    auto weights_view = model.bufferViews[weights_accessor.bufferView];
-                    buffer_weights = reinterpret_cast<const float*>(&(model.buffers[weights_view.buffer].data[
-                        weights_accessor.byteOffset + weights_view.byteOffset]));
-                    has_skin = true;
+                    index_buffer[index_start + i] = buf[i] + vertex_start;
                 }
-                has_skin = (buffer_joints && buffer_weights);
-
-                vertexCount = static_cast<uint32_t>(pos_accessor.count);
-
-                for (auto v = 0; v < pos_accessor.count; v++)
+                break;
+            }
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+            {
+                auto buf = reinterpret_cast<const uint16_t*>(index_data);
+                for(auto i=size_t{0};i<index_accessor.count;i++)
                 {
-                    auto vert = Vertex{};
-                    vert.position = glm::vec4(glm::make_vec3(&buffer_pos[v * 3]), 1.0f);
-                    vert.normal =
-                        glm::normalize(glm::vec3(buffer_normals ? glm::make_vec3(&buffer_normals[v * 3]) : glm::vec3(
-                            0.0f)));
-                    vert.uv = buffer_texcoords ? glm::make_vec2(&buffer_texcoords[v * 2]) : glm::vec2(0.0f);
-                    if (buffer_colors)
-                    {
-                        switch (num_color_component)
-                        {
-                        case 3:
-                            vert.color = glm::vec4(glm::make_vec3(&buffer_colors[v * 3]), 1.0f);
-                            break;
-                        case 4:
-                            vert.color = glm::make_vec4(&buffer_colors[v * 4]);
-                            break;
-                        default:
-                            vert.color = glm::vec4(1.0f);
-
-                        }
-                    }
-                    else
-                    {
-                        vert.color = glm::vec4(1.0f);
-                    }
-                    vert.tangent =
-                        buffer_tangents ? glm::vec4(glm::make_vec3(&buffer_tangents[v * 3]), 1.0f) : glm::vec4(0.0f);
-                    if (has_skin)
-                    {
-                        vert.joints_0 = glm::vec4(buffer_joints[v * 4 + 0],
-                            buffer_joints[v * 4 + 1],
-                            buffer_joints[v * 4 + 2],
-                            buffer_joints[v * 4 + 3]);
-                        vert.weights_0 = glm::vec4(buffer_weights[v * 4 + 0],
-                            buffer_weights[v * 4 + 1],
-                            buffer_weights[v * 4 + 2],
-                            buffer_weights[v * 4 + 3]);
-                    }
-                    else
-                    {
-                        vert.joints_0 = glm::vec4(0.0f);
-                        vert.weights_0 = glm::vec4(0.0f);
-                    }
-                    vertex_buffer.push_back(vert);
+                    index_buffer[index_start + i] = buf[i] + vertex_start;
                 }
+                break;
             }
-            // Indices
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
             {
-                auto index_accessor = model.accessors[primitive.indices];
-                auto index_view = model.bufferViews[index_accessor.bufferView];
-                auto index_buffer_ = model.buffers[index_view.buffer];
-                indexCount = static_cast<uint32_t>(index_accessor.count);
-                switch(index_accessor.componentType)
+                auto buf = reinterpret_cast<const uint8_t*>(index_data);
+                for(auto i=size_t{0};i<index_accessor.count;i++)
                 {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-                    {
-                        auto buf = new uint32_t[index_accessor.count];
-                        memcpy(buf, &index_buffer_.data[index_accessor.byteOffset+index_view.byteOffset], index_accessor.count * sizeof(uint32_t));
-                        for(auto i=0;i<index_accessor.count;i++)
-                        {
-                            index_buffer.push_back(buf[i] + vertexStart);
-                        }
-                        delete[] buf;
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
-                    {
-                        auto buf = new uint16_t[index_accessor.count];
-                        memcpy(buf, &index_buffer_.data[index_accessor.byteOffset+index_view.byteOffset], index_accessor.count * sizeof(uint16_t));
-                        for(auto i=0;i<index_accessor.count;i++)
-                        {
-                            index_buffer.push_back(buf[i] + vertexStart);
-                        }
-                        delete[] buf;
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
-                    {
-                        auto buf = new uint8_t[index_accessor.count];
-                        memcpy(buf, &index_buffer_.data[index_accessor.byteOffset+index_view.byteOffset], index_accessor.count * sizeof(uint8_t));
-                        for(auto i=0;i<index_accessor.count;i++)
-                        {
-                            index_buffer.push_back(buf[i] + vertexStart);
-                        }
-                        delete[] buf;
-                        break;
-                    }
-                    default:
-                        throw std::runtime_error("Index component type not supported");
-                        return;
+                    index_buffer[index_start + i] = buf[i] + vertex_start;
                 }
+                break;
             }
-            auto new_primitive = new Primitive(indexStart,indexCount,primitive.material > -1 ? materials[primitive.material] : materials.back());
-            new_primitive->first_index = vertexStart;
-            new_primitive->index_count = vertexCount;
-            new_primitive->set_dimensions(pos_min, pos_max);
-            newmesh->primitives.push_back(new_primitive);
+            default:
+                throw std::runtime_error("Index component type not supported");
+                return;
         }
-        newnode->mesh = newmesh;
     }
+}
 
+auto uka::gltf::Model::weld_vertices(const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    std::vector<uint32_t>& index_buffer,
+    std::vector<Vertex>& vertex_buffer) -> void
+{
+    using WeldKey = std::array<int64_t, 24>;
+    struct WeldKeyHash
+    {
+        auto operator()(const WeldKey& key) const -> size_t
+        {
+            auto hash = uint64_t{14695981039346656037ull};
+            for(auto value : key)
+            {
+                hash ^= static_cast<uint64_t>(value);
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+    // Values are snapped to a grid of the attribute's tolerance, a tolerance of 0 compares the exact bits
+    auto quantize = [](float value, float tolerance) -> int64_t
+    {
+        if(tolerance > 0.0f)
+        {
+            return static_cast<int64_t>(std::llround(static_cast<double>(value) / tolerance));
+        }
+        auto bits = uint32_t{0};
+        value = value == 0.0f ? 0.0f : value;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    };
+    const auto tolerances = weld_tolerances;
 
-    if(parent){
-        parent->children.push_back(newnode);
+    // Every primitive welds inside its own range and moves its unique vertices to the front of it
+    auto unique_counts = std::vector<uint32_t>(primitive_jobs.size());
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+    {
+        const auto* primitive = primitive_jobs[p].primitive;
+        auto* vertices = vertex_buffer.data() + primitive->first_vertex;
+        auto remap = std::vector<uint32_t>(primitive->vertex_count);
+        auto unique = std::unordered_map<WeldKey, uint32_t, WeldKeyHash>();
+        unique.reserve(primitive->vertex_count);
+        auto unique_count = uint32_t{0};
+        for(auto v = uint32_t{0}; v < primitive->vertex_count; v++)
+        {
+            const auto& vertex = vertices[v];
+            auto key = WeldKey{};
+            auto k = 0;
+            for(auto i = 0; i < 3; i++) key[k++] = quantize(vertex.position[i], tolerances.position);
+            for(auto i = 0; i < 3; i++) key[k++] = quantize(vertex.normal[i], tolerances.normal);
+            for(auto i = 0; i < 2; i++) key[k++] = quantize(vertex.uv[i], tolerances.uv);
+            for(auto i = 0; i < 4; i++) key[k++] = quantize(vertex.color[i], tolerances.color);
+            for(auto i = 0; i < 4; i++) key[k++] = quantize(vertex.tangent[i], tolerances.tangent);
+            for(auto i = 0; i < 4; i++) key[k++] = quantize(vertex.joints_0[i], 0.0f);
+            for(auto i = 0; i < 4; i++) key[k++] = quantize(vertex.weights_0[i], tolerances.weights);
+            auto found = unique.emplace(key, unique_count);
+            if(found.second)
+            {
+                vertices[unique_count++] = vertex;
+            }
+            remap[v] = found.first->second;
+        }
+        for(auto i = primitive->first_index; i < primitive->first_index + primitive->index_count; i++)
+        {
+            index_buffer[i] = remap[index_buffer[i] - primitive->first_vertex];
+        }
+        unique_counts[p] = unique_count;
+    });
+
+    // Close the gaps: ranges only move towards the front, so walking in order never overwrites live data
+    auto vertex_count = uint32_t{0};
+    for(auto p = size_t{0}; p < primitive_jobs.size(); p++)
+    {
+        auto* primitive = primitive_jobs[p].primitive;
+        if(primitive->first_vertex != vertex_count)
+        {
+            std::copy(vertex_buffer.begin() + primitive->first_vertex, vertex_buffer.begin() + primitive->first_vertex + unique_counts[p], vertex_buffer.begin() + vertex_count);
+        }
+        primitive->first_vertex = vertex_count;
+        primitive->vertex_count = unique_counts[p];
+        for(auto i = primitive->first_index; i < primitive->first_index + primitive->index_count; i++)
+        {
+            index_buffer[i] += vertex_count;
+        }
+        vertex_count += unique_counts[p];
     }
-    else
+    weld_statistics.vertices_before = static_cast<uint32_t>(vertex_buffer.size());
+    weld_statistics.vertices_after = vertex_count;
+    vertex_buffer.resize(vertex_count);
+}
+
+auto uka::gltf::Model::optimize_meshes(const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    std::vector<uint32_t>& index_buffer,
+    std::vector<Vertex>& vertex_buffer,
+    bool optimize_overdraw) -> void
+{
+    struct PrimitiveMisses
     {
-        nodes.push_back(newnode);
+        double before;
+        double after;
+    };
+    auto misses = std::vector<PrimitiveMisses>(primitive_jobs.size());
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+    {
+        const auto* primitive = primitive_jobs[p].primitive;
+        auto* indices = index_buffer.data() + primitive->first_index;
+        const auto index_count = primitive->index_count;
+        const auto first_vertex = primitive->first_vertex;
+        const auto vertex_count = primitive->vertex_count;
+        for(auto i = uint32_t{0}; i < index_count; i++)
+        {
+            indices[i] -= first_vertex;
+        }
+
+        auto before = uka::mesh::analyze_vertex_cache(indices, index_count, vertex_count);
+        uka::mesh::optimize_vertex_cache(indices, index_count, vertex_count);
+        if(optimize_overdraw)
+        {
+            uka::mesh::optimize_overdraw(indices, index_count, &vertex_buffer[first_vertex].position.x, sizeof(Vertex), vertex_count);
+        }
+        auto remap = std::vector<uint32_t>();
+        uka::mesh::optimize_vertex_fetch(indices, index_count, vertex_count, remap);
+        auto reordered = std::vector<Vertex>(vertex_count);
+        for(auto v = uint32_t{0}; v < vertex_count; v++)
+        {
+            reordered[remap[v]] = vertex_buffer[first_vertex + v];
+        }
+        std::copy(reordered.begin(), reordered.end(), vertex_buffer.begin() + first_vertex);
+        auto after = uka::mesh::analyze_vertex_cache(indices, index_count, vertex_count);
+
+        for(auto i = uint32_t{0}; i < index_count; i++)
+        {
+            indices[i] += first_vertex;
+        }
+        misses[p] = {double(before.acmr) * (index_count / 3), double(after.acmr) * (index_count / 3)};
+    });
+
+    auto triangles = double{0};
+    auto before = double{0};
+    auto after = double{0};
+    for(auto p = size_t{0}; p < primitive_jobs.size(); p++)
+    {
+        triangles += primitive_jobs[p].primitive->index_count / 3;
+        before += misses[p].before;
+        after += misses[p].after;
     }
-    linear_nodes.push_back(newnode);
+    if(triangles > 0 && !vertex_buffer.empty())
+    {
+        optimization_statistics.before = {float(before / triangles), float(before / vertex_buffer.size())};
+        optimization_statistics.after = {float(after / triangles), float(after / vertex_buffer.size())};
+    }
+}
+
+auto uka::gltf::Model::generate_lods(const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    std::vector<uint32_t>& index_buffer,
+    const std::vector<Vertex>& vertex_buffer) -> void
+{
+    // Each level halves the previous one until simplification stops paying off. Every level is simplified from the
+    // full mesh, so its error is measured against the full mesh rather than the level before it.
+    const auto max_lod_levels = 4;
+    auto primitive_levels = std::vector<std::vector<std::vector<uint32_t>>>(primitive_jobs.size());
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+    {
+        auto* primitive = primitive_jobs[p].primitive;
+        auto full = std::vector<uint32_t>(index_buffer.begin() + primitive->first_index, index_buffer.begin() + primitive->first_index + primitive->index_count);
+        for(auto& index : full)
+        {
+            index -= primitive->first_vertex;
+        }
+        const auto* positions = &vertex_buffer[primitive->first_vertex].position.x;
+        auto previous_size = full.size();
+        auto error = 0.0f;
+        for(auto i = 0; i < max_lod_levels; i++)
+        {
+            auto level_error = 0.0f;
+            auto simplified = uka::mesh::simplify(full.data(), full.size(), positions, sizeof(Vertex), primitive->vertex_count, previous_size / 2 / 3 * 3, std::numeric_limits<float>::max(), &level_error);
+            if(simplified.empty() || simplified.size() * 10 > previous_size * 9)
+            {
+                break;
+            }
+            uka::mesh::optimize_vertex_cache(simplified.data(), simplified.size(), primitive->vertex_count);
+            // Kept monotonic so select_lod can stop at the first level above its threshold
+            error = std::max(error, level_error);
+            primitive->lods.push_back({0, static_cast<uint32_t>(simplified.size()), error});
+            previous_size = simplified.size();
+            for(auto& index : simplified)
+            {
+                index += primitive->first_vertex;
+            }
+            primitive_levels[p].push_back(std::move(simplified));
+        }
+    });
 
+    for(auto p = size_t{0}; p < primitive_jobs.size(); p++)
+    {
+        auto* primitive = primitive_jobs[p].primitive;
+        for(auto i = size_t{0}; i < primitive_levels[p].size(); i++)
+        {
+            primitive->lods[i].first_index = static_cast<uint32_t>(index_buffer.size());
+            index_buffer.insert(index_buffer.end(), primitive_levels[p][i].begin(), primitive_levels[p][i].end());
+        }
+    }
 }
 
 auto uka::gltf::Model::load_skins(tinygltf::Model& gltf_model) -> void
 {
     for(auto& source : gltf_model.skins)
     {
-        auto new_skin = new Skin();
+        auto new_skin = scene_arena.create<Skin>();
         new_skin->name = source.name;
         if(source.skeleton > -1)
         {
@@ -981,24 +1337,171 @@ auto uka::gltf::Model::load_skins(tinygltf::Model& gltf_model) -> void
 
         if(source.inverseBindMatrices > -1)
         {
-            auto accessor = gltf_model.accessors[source.inverseBindMatrices];
-            auto bufferView = gltf_model.bufferViews[accessor.bufferView];
-            auto buffer = gltf_model.buffers[bufferView.buffer];
+            const auto& accessor = gltf_model.accessors[source.inverseBindMatrices];
             new_skin->inverse_bind_matrices.resize(accessor.count);
-            memcpy(new_skin->inverse_bind_matrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+            memcpy(new_skin->inverse_bind_matrices.data(), accessor_data(gltf_model, accessor), accessor.count * sizeof(glm::mat4));
         }
         skins.push_back(new_skin);
     }
 }
 
-auto uka::gltf::Model::load_image(tinygltf::Model& gltf_model, uka::Uka_Device* device, VkQueue transfer_queue) -> void
+// 2x2 box filter from a width x height level to the next smaller one, odd edges repeat their last texel
+static auto downsample_rgba8(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination) -> void
+{
+    const auto destination_width = std::max(width / 2, 1u);
+    const auto destination_height = std::max(height / 2, 1u);
+    for(auto y = uint32_t{0}; y < destination_height; y++)
+    {
+        const auto* row0 = source + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+        const auto* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+        for(auto x = uint32_t{0}; x < destination_width; x++)
+        {
+            const auto x0 = std::min(x * 2, width - 1) * 4;
+            const auto x1 = std::min(x * 2 + 1, width - 1) * 4;
+            for(auto c = 0; c < 4; c++)
+            {
+                destination[c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+            destination += 4;
+        }
+    }
+}
+
+// Every level of a glTF image packed back to back, generated on the CPU for images that only come with level 0
+static auto load_image_levels(const tinygltf::Image& gltf_image, const std::string& path, uka::Uka_Device* device, VkFormat& format, uint32_t& width, uint32_t& height, uint32_t& mip_levels, uka::gltf::Model::TextureStreaming::Source& source) -> void
+{
+    auto& offsets = source.level_offsets;
+    format = VK_FORMAT_R8G8B8A8_UNORM;
+    if(is_ktx_image(gltf_image))
+    {
+        const auto ktx_image = uka::gltf::Texture::open_ktx(gltf_image, path, device);
+        auto* ktx_texture = ktx_image.texture;
+        format = ktx_image.format;
+        width = ktx_texture->baseWidth;
+        height = ktx_texture->baseHeight;
+        mip_levels = ktx_texture->numLevels;
+        offsets.assign(1, 0);
+        for(auto level = uint32_t{0}; level < mip_levels; level++)
+        {
+            offsets.push_back(offsets.back() + ktxTexture_GetImageSize(ktx_texture, level));
+        }
+        source.data.resize(offsets.back());
+        for(auto level = uint32_t{0}; level < mip_levels; level++)
+        {
+            auto offset = ktx_size_t{};
+            auto result = ktxTexture_GetImageOffset(ktx_texture, level, 0, 0, &offset);
+            assert(result == KTX_SUCCESS);
+            memcpy(source.data.data() + offsets[level], ktxTexture_GetData(ktx_texture) + offset, offsets[level + 1] - offsets[level]);
+        }
+        ktxTexture_Destroy(ktx_texture);
+        return;
+    }
+
+    width = gltf_image.width;
+    height = gltf_image.height;
+    mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    offsets.assign(1, 0);
+    for(auto level = uint32_t{0}; level < mip_levels; level++)
+    {
+        offsets.push_back(offsets.back() + static_cast<size_t>(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4);
+    }
+    source.data.resize(offsets.back());
+    const auto texel_count = static_cast<size_t>(width) * height;
+    if(gltf_image.component == 3)
+    {
+        uka::pixel::rgb_to_rgba(&gltf_image.image[0], source.data.data(), texel_count);
+    }
+    else
+    {
+        memcpy(source.data.data(), &gltf_image.image[0], texel_count * 4);
+    }
+    for(auto level = uint32_t{1}; level < mip_levels; level++)
+    {
+        downsample_rgba8(source.data.data() + offsets[level - 1], std::max(1u, width >> (level - 1)), std::max(1u, height >> (level - 1)), source.data.data() + offsets[level]);
+    }
+}
+
+auto uka::gltf::Model::load_image(tinygltf::Model& gltf_model, uka::Uka_Device* device, VkQueue transfer_queue, uint32_t file_loading_flags) -> void
 {
-    for(auto img :gltf_model.images)
+    if(!gltf_model.images.empty() && (file_loading_flags & LoadFlags::STREAM_TEXTURES))
+    {
+        // Levels are decoded on the pool, only the mip tail goes out with the model
+        struct StreamedImage
+        {
+            VkFormat format;
+            uint32_t width, height, mip_levels, tail_level;
+        };
+        auto& sources = texture_streaming.sources;
+        sources.resize(gltf_model.images.size());
+        auto images = std::vector<StreamedImage>(gltf_model.images.size());
+        uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(gltf_model.images.size()), [&](uint32_t i)
+        {
+            auto& image = images[i];
+            sources[i].texture = i;
+            load_image_levels(gltf_model.images[i], path, device, image.format, image.width, image.height, image.mip_levels, sources[i]);
+            image.tail_level = 0;
+            while(image.tail_level + 1 < image.mip_levels && std::max(image.width >> image.tail_level, image.height >> image.tail_level) > streaming_tail_size)
+            {
+                image.tail_level++;
+            }
+        });
+
+        auto staging_size = VkDeviceSize{0};
+        for(auto i = size_t{0}; i < sources.size(); i++)
+        {
+            const auto& offsets = sources[i].level_offsets;
+            staging_size += offsets.back() - offsets[images[i].tail_level] + 16 * images[i].mip_levels;
+        }
+        auto batch = Uka_Upload_Batch(device);
+        batch.begin(staging_size);
+        textures.reserve(gltf_model.images.size());
+        for(auto i = size_t{0}; i < sources.size(); i++)
+        {
+            const auto& image = images[i];
+            auto texture = Texture();
+            texture.from_levels(sources[i].data.data(), sources[i].level_offsets.data(), image.format, image.width, image.height, image.mip_levels, image.tail_level, device, batch);
+            texture.index = static_cast<uint32_t>(textures.size());
+            textures.push_back(texture);
+        }
+        batch.submit(transfer_queue);
+
+        // Fully resident images have nothing left to stream
+        sources.erase(std::remove_if(sources.begin(), sources.end(), [&](const TextureStreaming::Source& source) { return textures[source.texture].resident_level == 0; }), sources.end());
+        if(!sources.empty())
+        {
+            vkGetDeviceQueue(device->logical_device, device->queue_family_indices.transfer, 0, &texture_streaming.queue);
+            texture_streaming.command_pool = device->create_command_pool(device->queue_family_indices.transfer);
+            texture_streaming.batch = std::make_unique<Uka_Upload_Batch>(device, texture_streaming.command_pool);
+        }
+    }
+    // Every image shares one staging buffer and one submission
+    else if(!gltf_model.images.empty())
     {
-        auto texture = Texture();
-        texture.from_gltf_image(img,path,device,transfer_queue);
-        texture.index = static_cast<uint32_t>(textures.size());
-        textures.push_back(texture);
+        // KTX files are read, inflated and transcoded on the pool
+        auto ktx_images = std::vector<Texture::KtxImage>(gltf_model.images.size());
+        uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(gltf_model.images.size()), [&](uint32_t i)
+        {
+            if(is_ktx_image(gltf_model.images[i]))
+            {
+                ktx_images[i] = Texture::open_ktx(gltf_model.images[i], path, device);
+            }
+        });
+        auto staging_size = VkDeviceSize{0};
+        for(auto i = size_t{0}; i < gltf_model.images.size(); i++)
+        {
+            staging_size += Texture::staging_size(gltf_model.images[i], path, ktx_images[i]);
+        }
+        auto batch = Uka_Upload_Batch(device);
+        batch.begin(staging_size);
+        textures.reserve(gltf_model.images.size());
+        for(auto i = size_t{0}; i < gltf_model.images.size(); i++)
+        {
+            auto texture = Texture();
+            texture.from_gltf_image(gltf_model.images[i], path, device, batch, ktx_images[i]);
+            texture.index = static_cast<uint32_t>(textures.size());
+            textures.push_back(texture);
+        }
+        batch.submit(transfer_queue);
     }
     create_empty_texture(transfer_queue);
 }
@@ -1061,6 +1564,42 @@ auto uka::gltf::Model::load_materials(tinygltf::Model& gltf_model) -> void
     materials.push_back(Material(device));
 }
 
+// Repacks an animation's samplers into per-path streams, cubic spline keys keep only their value and play back linearly
+static auto animation_clip(const uka::gltf::Animation& animation) -> uka::animation::Clip
+{
+    auto clip = uka::animation::Clip{};
+    clip.name = animation.name;
+    clip.start = animation.start;
+    clip.end = animation.end;
+    for(const auto& channel : animation.channels)
+    {
+        const auto& sampler = animation.samplers[channel.sampler_index];
+        auto key_count = static_cast<uint32_t>(sampler.inputs.size());
+        auto cubic = sampler.interpolation == uka::gltf::AnimationSampler::InterpolationType::CUBICSPLINE;
+        if(key_count == 0 || sampler.outputs.size() < size_t{key_count} * (cubic ? 3 : 1))
+        {
+            continue;
+        }
+        auto mode = sampler.interpolation == uka::gltf::AnimationSampler::InterpolationType::STEP ? uka::animation::Interpolation::step : uka::animation::Interpolation::linear;
+        const auto* values = glm::value_ptr(sampler.outputs[cubic ? 1 : 0]);
+        auto stride = size_t{cubic ? 12u : 4u};
+        auto target = channel.target_node->linear_index;
+        switch(channel.path)
+        {
+            case uka::gltf::AnimationChannel::PathType::TRANSLATION:
+                clip.translation.add_channel(target, mode, sampler.inputs.data(), values, stride, key_count);
+                break;
+            case uka::gltf::AnimationChannel::PathType::ROTATION:
+                clip.rotation.add_channel(target, mode, sampler.inputs.data(), values, stride, key_count);
+                break;
+            case uka::gltf::AnimationChannel::PathType::SCALE:
+                clip.scale.add_channel(target, mode, sampler.inputs.data(), values, stride, key_count);
+                break;
+        }
+    }
+    return clip;
+}
+
 auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
 {
     for(auto& anim:gltf_model.animations)
@@ -1090,13 +1629,11 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
             }
 
             {
-                auto accessor = gltf_model.accessors[samp.input];
-                auto bufferView = gltf_model.bufferViews[accessor.bufferView];
-                auto buffer = gltf_model.buffers[bufferView.buffer];
+                const auto& accessor = gltf_model.accessors[samp.input];
                 assert(accessor.componentType == TINYGLTF_PARAMETER_TYPE_FLOAT);
 
                 auto *buf = new float[accessor.count];
-                memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
+                memcpy(buf, accessor_data(gltf_model, accessor), accessor.count * sizeof(float));
                 for(auto i=0;i<accessor.count;i++)
                 {
                     sample.inputs.push_back(buf[i]);
@@ -1115,9 +1652,7 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
                 }
             }
             {
-                auto accessor = gltf_model.accessors[samp.output];
-                auto bufferView = gltf_model.bufferViews[accessor.bufferView];
-                auto buffer = gltf_model.buffers[bufferView.buffer];
+                const auto& accessor = gltf_model.accessors[samp.output];
                 assert(accessor.componentType == TINYGLTF_PARAMETER_TYPE_FLOAT);
 
                 switch(accessor.type)
@@ -1125,7 +1660,7 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
                     case TINYGLTF_TYPE_VEC3:
                     {
                         auto *buf = new glm::vec3[accessor.count];
-                        memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
+                        memcpy(buf, accessor_data(gltf_model, accessor), accessor.count * sizeof(glm::vec3));
                         for(auto i=0;i<accessor.count;i++)
                         {
                             sample.outputs.push_back(glm::vec4 (buf[i],0.0f));
@@ -1136,7 +1671,7 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
                     case TINYGLTF_TYPE_VEC4:
                     {
                         auto *buf = new glm::vec4[accessor.count];
-                        memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
+                        memcpy(buf, accessor_data(gltf_model, accessor), accessor.count * sizeof(glm::vec4));
                         for(auto i=0;i<accessor.count;i++)
                         {
                             sample.outputs.push_back(buf[i]);
@@ -1149,6 +1684,7 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
                         break;
                 }
             }
+            animation.samplers.push_back(std::move(sample));
         }
 
         for(auto& source : anim.channels)
@@ -1174,75 +1710,688 @@ auto uka::gltf::Model::load_animations(tinygltf::Model& gltf_model) -> void
             }
             animation.channels.push_back(channel);
         }
-        animations.push_back(animation);
+        animation_clips.push_back(animation_clip(animation));
+        animation_cursors.emplace_back(animation_clips.back());
+        animations.push_back(std::move(animation));
+    }
+
+    rest_pose.resize(linear_nodes.size());
+    for(auto i = size_t{0}; i < linear_nodes.size(); i++)
+    {
+        const auto* node = linear_nodes[i];
+        for(auto c = 0; c < 3; c++)
+        {
+            rest_pose.translation[c][i] = node->translation[c];
+            rest_pose.scale[c][i] = node->scale[c];
+        }
+        rest_pose.rotation[0][i] = node->rotation.x;
+        rest_pose.rotation[1][i] = node->rotation.y;
+        rest_pose.rotation[2][i] = node->rotation.z;
+        rest_pose.rotation[3][i] = node->rotation.w;
     }
+    animated_pose = rest_pose;
 }
 
-auto uka::gltf::Model::load_form_file(std::string filename,
-    uka::Uka_Device* device,
-    VkQueue transfer_queue,
-    uka::gltf::LoadFlags file_loading_flags,
-    float scale) -> void
+auto uka::gltf::AnimationSampler::find_key(float time, uint32_t& cursor) const -> bool
 {
-    auto gltf_model = tinygltf::Model();
-    auto gltf_context = tinygltf::TinyGLTF();
-    if(file_loading_flags & uka::gltf::LoadFlags::DONT_LOAD_IMAGES)
+    if(inputs.size() < 2 || time < inputs.front() || time > inputs.back())
     {
-        gltf_context.SetImageLoader(load_image_data_function_empty, nullptr);
+        return false;
     }
-    else
+    uka::animation::find_key(inputs.data(), static_cast<uint32_t>(inputs.size()), time, cursor);
+    return true;
+}
+
+auto uka::gltf::Model::read_mapped_file(std::vector<unsigned char>* out,
+    std::string* err,
+    const std::string& file_path,
+    void* user_data) -> bool
+{
+    // tinygltf insists on owning a copy; the mapping stays alive so bind_buffer_data can point back into it
+    auto* model = static_cast<Model*>(user_data);
+    auto file = uka::Uka_Mapped_File();
+    if(!file.open(file_path))
     {
-        gltf_context.SetImageLoader(load_image_data_function, nullptr);
+        if(err)
+        {
+            (*err) += "Failed to map file: " + file_path + "\n";
+        }
+        return false;
     }
-    size_t pos = filename.find_last_of('/');
-    path = filename.substr(0, pos);
-    std::string err,warn;
-    this->device = device;
-
-    bool file_loaded = gltf_context.LoadASCIIFromFile(&gltf_model, &err, &warn, filename);
-
-    auto index_buffer = std::vector<uint32_t>();
-    auto vertex_buffer = std::vector<Vertex>();
+    out->assign(file.data, file.data + file.size);
+    model->mapped_files.push_back(std::move(file));
+    return true;
+}
 
-    if(file_loaded)
+auto uka::gltf::Model::bind_buffer_data(tinygltf::Model& gltf_model, bool binary) -> void
+{
+    buffer_data.resize(gltf_model.buffers.size());
+    for(auto i = size_t{0}; i < gltf_model.buffers.size(); i++)
     {
-        if(file_loading_flags & uka::gltf::LoadFlags::DONT_LOAD_IMAGES)
+        auto& buffer = gltf_model.buffers[i];
+        buffer_data[i] = buffer.data.data();
+
+        const unsigned char* mapped = nullptr;
+        if(buffer.uri.empty() && binary && !mapped_files.empty())
         {
-            load_image(gltf_model, device, transfer_queue);
+            // GLB: the BIN chunk follows the 12 byte header and the JSON chunk. Anything else keeps tinygltf's copy.
+            const auto& file = mapped_files.front();
+            uint32_t json_length = 0;
+            if(file.size >= 20)
+            {
+                memcpy(&json_length, file.data + 12, sizeof(uint32_t));
+            }
+            auto bin_chunk = size_t{20} + json_length;
+            if(bin_chunk + 8 <= file.size)
+            {
+                uint32_t bin_length = 0;
+                memcpy(&bin_length, file.data + bin_chunk, sizeof(uint32_t));
+                auto is_bin = memcmp(file.data + bin_chunk + 4, "BIN\0", 4) == 0;
+                if(is_bin && bin_length >= buffer.data.size() && bin_chunk + 8 + bin_length <= file.size)
+                {
+                    mapped = file.data + bin_chunk + 8;
+                }
+            }
         }
-        load_materials(gltf_model);
-        auto scene = gltf_model.scenes[gltf_model.defaultScene > -1 ? gltf_model.defaultScene : 0];
-        for(auto nodeIndex : scene.nodes)
+        else if(!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0)
+        {
+            for(auto& file : mapped_files)
+            {
+                auto uri_match = file.path.size() >= buffer.uri.size() && file.path.compare(file.path.size() - buffer.uri.size(), buffer.uri.size(), buffer.uri) == 0;
+                if(uri_match && file.size == buffer.data.size())
+                {
+                    mapped = file.data;
+                    break;
+                }
+            }
+        }
+        if(mapped)
         {
-            load_node(nullptr, gltf_model.nodes[nodeIndex], nodeIndex, gltf_model, index_buffer, vertex_buffer, scale);
+            buffer_data[i] = mapped;
+            std::vector<unsigned char>().swap(buffer.data);
         }
-        if(gltf_model.skins.size() > 0)
+    }
+}
+
+static auto octahedral_encode(glm::vec3 n) -> glm::vec2
+{
+    n /= (std::abs(n.x) + std::abs(n.y) + std::abs(n.z) + 1e-20f);
+    auto p = glm::vec2(n.x, n.y);
+    if(n.z < 0.0f)
+    {
+        auto sign = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (glm::vec2(1.0f) - glm::abs(glm::vec2(p.y, p.x))) * sign;
+    }
+    return p;
+}
+
+auto uka::gltf::Model::pack_vertices(const Vertex* vertex_data,
+    uint32_t vertex_count,
+    const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    const VertexLayout& vertex_layout) -> std::vector<unsigned char>
+{
+    auto packed = std::vector<unsigned char>(size_t{vertex_count} * vertex_layout.stride);
+    const auto compression = vertex_compression_flags;
+    // Streams are stored back to back, an interleaved layout is a single stream
+    size_t stream_bases[3] = {0, 0, 0};
+    for(auto stream = 1; stream < 3; stream++)
+    {
+        stream_bases[stream] = stream_bases[stream - 1] + size_t{vertex_count} * vertex_layout.stream_strides[stream - 1];
+    }
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+    {
+        auto primitive = primitive_jobs[p].primitive;
+        // Quantize against the actual vertex bounds, pre-transform may have moved them away from the accessor min/max
+        auto min = glm::vec3(std::numeric_limits<float>::max());
+        auto max = glm::vec3(std::numeric_limits<float>::lowest());
+        for(auto v = primitive->first_vertex; v < primitive->first_vertex + primitive->vertex_count; v++)
         {
-            load_skins(gltf_model);
+            min = glm::min(min, vertex_data[v].position);
+            max = glm::max(max, vertex_data[v].position);
         }
-        if(gltf_model.animations.size() > 0)
+        auto extent = glm::max(max - min, glm::vec3(1e-20f));
+        if(compression & COMPRESS_POSITION_UNORM16)
         {
-            load_animations(gltf_model);
+            primitive->dequantization.offset = glm::vec4(min, 0.0f);
+            primitive->dequantization.scale = glm::vec4(extent, 1.0f);
         }
-        for(auto node : linear_nodes)
+
+        for(auto v = primitive->first_vertex; v < primitive->first_vertex + primitive->vertex_count; v++)
         {
-            if(node->skin_index > -1)
+            const auto& vertex = vertex_data[v];
+            auto write = [&](VertexComponent component, const void* data, size_t size)
             {
-                node->skin = skins[node->skin_index];
+                auto stream = vertex_layout.streams[component];
+                memcpy(packed.data() + stream_bases[stream] + size_t{v} * vertex_layout.stream_strides[stream] + vertex_layout.offsets[component], data, size);
+            };
+
+            if(compression & COMPRESS_POSITION_UNORM16)
+            {
+                auto position = glm::packUnorm4x16(glm::vec4((vertex.position - min) / extent, 1.0f));
+                write(VertexComponent::POSITION, &position, sizeof(position));
             }
-            if(node->mesh)
+            else
             {
-                node->update();
+                write(VertexComponent::POSITION, &vertex.position, sizeof(vertex.position));
             }
-        }
-    }
-    else
-    {
+            if(compression & COMPRESS_NORMAL_OCTAHEDRAL)
+            {
+                auto normal = glm::packSnorm2x16(octahedral_encode(vertex.normal));
+                auto tangent = glm::packSnorm4x8(glm::vec4(octahedral_encode(glm::vec3(vertex.tangent)), 0.0f, vertex.tangent.w < 0.0f ? -1.0f : 1.0f));
+                write(VertexComponent::NORMAL, &normal, sizeof(normal));
+                write(VertexComponent::TANGENT, &tangent, sizeof(tangent));
+            }
+            else
+            {
+                write(VertexComponent::NORMAL, &vertex.normal, sizeof(vertex.normal));
+                write(VertexComponent::TANGENT, &vertex.tangent, sizeof(vertex.tangent));
+            }
+            if(compression & COMPRESS_UV_HALF)
+            {
+                auto uv = glm::packHalf2x16(vertex.uv);
+                write(VertexComponent::UV, &uv, sizeof(uv));
+            }
+            else
+            {
+                write(VertexComponent::UV, &vertex.uv, sizeof(vertex.uv));
+            }
+            if(compression & COMPRESS_COLOR_UNORM8)
+            {
+                auto color = glm::packUnorm4x8(vertex.color);
+                auto weights = glm::packUnorm4x8(vertex.weights_0);
+                write(VertexComponent::COLOR, &color, sizeof(color));
+                write(VertexComponent::WEIGHTS, &weights, sizeof(weights));
+            }
+            else
+            {
+                write(VertexComponent::COLOR, &vertex.color, sizeof(vertex.color));
+                write(VertexComponent::WEIGHTS, &vertex.weights_0, sizeof(vertex.weights_0));
+            }
+            if(compression & COMPRESS_JOINTS_UINT8)
+            {
+                uint8_t joints[4] = {uint8_t(vertex.joints_0.x), uint8_t(vertex.joints_0.y), uint8_t(vertex.joints_0.z), uint8_t(vertex.joints_0.w)};
+                write(VertexComponent::JOINTS, joints, sizeof(joints));
+            }
+            else if(compression & COMPRESS_JOINTS_UINT16)
+            {
+                uint16_t joints[4] = {uint16_t(vertex.joints_0.x), uint16_t(vertex.joints_0.y), uint16_t(vertex.joints_0.z), uint16_t(vertex.joints_0.w)};
+                write(VertexComponent::JOINTS, joints, sizeof(joints));
+            }
+            else
+            {
+                write(VertexComponent::JOINTS, &vertex.joints_0, sizeof(vertex.joints_0));
+            }
+        }
+    });
+    return packed;
+}
+
+auto uka::gltf::Model::build_meshlets(const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    const Vertex* vertex_data,
+    const uint32_t* index_data) -> void
+{
+    auto primitive_meshlets = std::vector<std::vector<uka::mesh::Meshlet>>(primitive_jobs.size());
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+    {
+        const auto* primitive = primitive_jobs[p].primitive;
+        auto local_indices = std::vector<uint32_t>(index_data + primitive->first_index, index_data + primitive->first_index + primitive->index_count);
+        for(auto& index : local_indices)
+        {
+            index -= primitive->first_vertex;
+        }
+        primitive_meshlets[p] = uka::mesh::build_meshlets(local_indices.data(), local_indices.size(), &vertex_data[primitive->first_vertex].position.x, sizeof(Vertex), primitive->vertex_count);
+    });
+
+    meshlets.clear();
+    for(auto p = size_t{0}; p < primitive_jobs.size(); p++)
+    {
+        auto* primitive = primitive_jobs[p].primitive;
+        primitive->first_meshlet = static_cast<uint32_t>(meshlets.size());
+        primitive->meshlet_count = static_cast<uint32_t>(primitive_meshlets[p].size());
+        for(auto meshlet : primitive_meshlets[p])
+        {
+            meshlet.first_index += primitive->first_index;
+            meshlets.push_back(meshlet);
+        }
+    }
+}
+
+// Flat geometry cache: header, key, primitive records, LOD records, then the vertex and index blobs, each 16 byte aligned
+struct GeometryCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t key_size;
+    uint32_t vertex_stride;
+    uint32_t primitive_count;
+    uint32_t lod_count;
+    uint32_t vertex_count;
+    uint32_t index_count;
+};
+
+struct GeometryCachePrimitive
+{
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t material_index;
+    uint32_t lod_count;
+    float min[3];
+    float max[3];
+};
+
+struct GeometryCacheLod
+{
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+};
+
+static const char geometry_cache_magic[8] = {'U', 'K', 'A', 'G', 'E', 'O', 'M', '\0'};
+static const uint32_t geometry_cache_version = 3;
+
+static auto geometry_cache_align(size_t offset) -> size_t
+{
+    return (offset + 15) & ~size_t{15};
+}
+
+static auto file_stamp(const std::string& file_path) -> std::string
+{
+    auto error = std::error_code{};
+    auto size = std::filesystem::file_size(file_path, error);
+    if(error)
+    {
+        return "missing";
+    }
+    auto mtime = std::filesystem::last_write_time(file_path, error);
+    return std::to_string(size) + ":" + std::to_string(mtime.time_since_epoch().count());
+}
+
+auto uka::gltf::Model::geometry_cache_key(const std::string& filename,
+    const tinygltf::Model& gltf_model,
+    uint32_t file_loading_flags,
+    float scale) const -> std::string
+{
+    // Anything that changes the decoded bytes goes into the key, it is stored verbatim and compared on load
+    auto key = filename + "|" + file_stamp(filename);
+    for(const auto& buffer : gltf_model.buffers)
+    {
+        if(!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0)
+        {
+            key += "|" + buffer.uri + "=" + file_stamp(path + "/" + buffer.uri);
+        }
+    }
+    // Flags that only affect how the file is read do not change the output
+    auto geometry_flags = file_loading_flags & ~(LoadFlags::MEMORY_MAP_BUFFERS | LoadFlags::CACHE_GEOMETRY | LoadFlags::DONT_LOAD_IMAGES);
+    key += "|flags=" + std::to_string(geometry_flags) + "|scale=" + std::to_string(scale) + "|vertex=" + std::to_string(sizeof(Vertex));
+    if(file_loading_flags & LoadFlags::WELD_VERTICES)
+    {
+        const auto& t = weld_tolerances;
+        key += "|weld=" + std::to_string(t.position) + "," + std::to_string(t.normal) + "," + std::to_string(t.uv) + "," + std::to_string(t.color) + "," + std::to_string(t.tangent) + "," + std::to_string(t.weights);
+    }
+    return key;
+}
+
+auto uka::gltf::Model::geometry_cache_path(const std::string& filename) const -> std::string
+{
+    if(model_cache_directory.empty())
+    {
+        return filename + ".ukacache";
+    }
+    // FNV-1a of the asset path keeps caches of equally named assets apart
+    auto hash = uint64_t{14695981039346656037ull};
+    for(auto c : filename)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return model_cache_directory + "/" + name + ".ukacache";
+}
+
+auto uka::gltf::Model::read_geometry_cache(const uka::Uka_Mapped_File& cache,
+    const std::string& key,
+    const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    const Vertex** vertex_data,
+    uint32_t& vertex_count,
+    const uint32_t** index_data,
+    uint32_t& index_count) -> bool
+{
+    auto header = GeometryCacheHeader{};
+    if(cache.size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, cache.data, sizeof(header));
+    if(memcmp(header.magic, geometry_cache_magic, sizeof(header.magic)) != 0 || header.version != geometry_cache_version)
+    {
+        return false;
+    }
+    if(header.vertex_stride != sizeof(Vertex) || header.primitive_count != primitive_jobs.size() || header.key_size != key.size())
+    {
+        return false;
+    }
+    auto offset = sizeof(header);
+    auto primitive_offset = geometry_cache_align(offset + header.key_size);
+    auto lod_offset = geometry_cache_align(primitive_offset + size_t{header.primitive_count} * sizeof(GeometryCachePrimitive));
+    auto vertex_offset = geometry_cache_align(lod_offset + size_t{header.lod_count} * sizeof(GeometryCacheLod));
+    auto index_offset = geometry_cache_align(vertex_offset + size_t{header.vertex_count} * sizeof(Vertex));
+    if(index_offset + size_t{header.index_count} * sizeof(uint32_t) > cache.size)
+    {
+        return false;
+    }
+    if(memcmp(cache.data + offset, key.data(), key.size()) != 0)
+    {
+        return false;
+    }
+
+    auto records = reinterpret_cast<const GeometryCachePrimitive*>(cache.data + primitive_offset);
+    auto lod_records = reinterpret_cast<const GeometryCacheLod*>(cache.data + lod_offset);
+    // Every range must lie inside the cached blobs, checked before any primitive is touched so a rejected
+    // cache falls back to decoding cleanly
+    auto within = [](uint32_t first, uint32_t count, uint32_t total) { return uint64_t{first} + count <= total; };
+    auto total_lods = size_t{0};
+    for(auto i = size_t{0}; i < primitive_jobs.size(); i++)
+    {
+        const auto& record = records[i];
+        if(record.material_index >= materials.size() || !within(record.first_index, record.index_count, header.index_count) || !within(record.first_vertex, record.vertex_count, header.vertex_count))
+        {
+            return false;
+        }
+        total_lods += record.lod_count;
+    }
+    if(total_lods != header.lod_count)
+    {
+        return false;
+    }
+    for(auto l = size_t{0}; l < total_lods; l++)
+    {
+        if(!within(lod_records[l].first_index, lod_records[l].index_count, header.index_count))
+        {
+            return false;
+        }
+    }
+    for(auto i = size_t{0}; i < primitive_jobs.size(); i++)
+    {
+        const auto& record = records[i];
+        auto primitive = primitive_jobs[i].primitive;
+        primitive->lods.clear();
+        for(auto l = uint32_t{0}; l < record.lod_count; l++, lod_records++)
+        {
+            primitive->lods.push_back({lod_records->first_index, lod_records->index_count, lod_records->error});
+        }
+        primitive->first_index = record.first_index;
+        primitive->index_count = record.index_count;
+        primitive->first_vertex = record.first_vertex;
+        primitive->vertex_count = record.vertex_count;
+        primitive->material_index = record.material_index;
+        primitive->material = materials[record.material_index];
+        primitive->set_dimensions(glm::make_vec3(record.min), glm::make_vec3(record.max));
+    }
+    *vertex_data = reinterpret_cast<const Vertex*>(cache.data + vertex_offset);
+    *index_data = reinterpret_cast<const uint32_t*>(cache.data + index_offset);
+    vertex_count = header.vertex_count;
+    index_count = header.index_count;
+    return true;
+}
+
+auto uka::gltf::Model::write_geometry_cache(const std::string& cache_path,
+    const std::string& key,
+    const std::vector<PrimitiveLoadJob>& primitive_jobs,
+    const std::vector<Vertex>& vertex_buffer,
+    const std::vector<uint32_t>& index_buffer) -> void
+{
+    auto header = GeometryCacheHeader{};
+    memcpy(header.magic, geometry_cache_magic, sizeof(header.magic));
+    header.version = geometry_cache_version;
+    header.key_size = static_cast<uint32_t>(key.size());
+    header.vertex_stride = sizeof(Vertex);
+    header.primitive_count = static_cast<uint32_t>(primitive_jobs.size());
+    header.lod_count = 0;
+    header.vertex_count = static_cast<uint32_t>(vertex_buffer.size());
+    header.index_count = static_cast<uint32_t>(index_buffer.size());
+
+    auto records = std::vector<GeometryCachePrimitive>(primitive_jobs.size());
+    auto lod_records = std::vector<GeometryCacheLod>();
+    for(auto i = size_t{0}; i < primitive_jobs.size(); i++)
+    {
+        const auto* primitive = primitive_jobs[i].primitive;
+        auto& record = records[i];
+        record.first_index = primitive->first_index;
+        record.index_count = primitive->index_count;
+        record.first_vertex = primitive->first_vertex;
+        record.vertex_count = primitive->vertex_count;
+        record.material_index = primitive->material_index;
+        record.lod_count = static_cast<uint32_t>(primitive->lods.size());
+        for(const auto& lod : primitive->lods)
+        {
+            lod_records.push_back({lod.first_index, lod.index_count, lod.error});
+        }
+        memcpy(record.min, &primitive->dimensions.min, sizeof(record.min));
+        memcpy(record.max, &primitive->dimensions.max, sizeof(record.max));
+    }
+    header.lod_count = static_cast<uint32_t>(lod_records.size());
+
+    // Write next to the target and rename so a crashed or concurrent writer never leaves a torn cache behind
+    auto temp_path = cache_path + ".tmp";
+    {
+        auto file = std::ofstream(temp_path, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            std::cerr << "Could not write geometry cache: " << cache_path << "\n";
+            return;
+        }
+        const char padding[16] = {};
+        auto offset = size_t{0};
+        auto write = [&](const void* data, size_t size)
+        {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            offset += size;
+        };
+        auto align = [&]()
+        {
+            write(padding, geometry_cache_align(offset) - offset);
+        };
+        write(&header, sizeof(header));
+        write(key.data(), key.size());
+        align();
+        write(records.data(), records.size() * sizeof(GeometryCachePrimitive));
+        align();
+        write(lod_records.data(), lod_records.size() * sizeof(GeometryCacheLod));
+        align();
+        write(vertex_buffer.data(), vertex_buffer.size() * sizeof(Vertex));
+        align();
+        write(index_buffer.data(), index_buffer.size() * sizeof(uint32_t));
+        if(!file)
+        {
+            std::cerr << "Could not write geometry cache: " << cache_path << "\n";
+            return;
+        }
+    }
+    auto error = std::error_code{};
+    std::filesystem::rename(temp_path, cache_path, error);
+    if(error)
+    {
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+auto uka::gltf::Model::load_form_file(std::string filename,
+    uka::Uka_Device* device,
+    VkQueue transfer_queue,
+    uka::gltf::LoadFlags file_loading_flags,
+    float scale) -> void
+{
+    auto gltf_model = tinygltf::Model();
+    auto gltf_context = tinygltf::TinyGLTF();
+    if(file_loading_flags & uka::gltf::LoadFlags::DONT_LOAD_IMAGES)
+    {
+        gltf_context.SetImageLoader(load_image_data_function_empty, nullptr);
+    }
+    else
+    {
+        gltf_context.SetImageLoader(load_image_data_function, nullptr);
+    }
+    size_t pos = filename.find_last_of('/');
+    path = filename.substr(0, pos);
+    std::string err,warn;
+    this->device = device;
+    vertex_compression_flags = vertex_compression;
+
+    auto binary = filename.substr(filename.find_last_of('.') + 1) == "glb";
+    auto file_loaded = false;
+    if(file_loading_flags & uka::gltf::LoadFlags::MEMORY_MAP_BUFFERS)
+    {
+        // Parse straight from the mapping and keep external buffers mapped so accessors decode without a copy
+        auto fs_callbacks = tinygltf::FsCallbacks{};
+        fs_callbacks.FileExists = &tinygltf::FileExists;
+        fs_callbacks.ExpandFilePath = &tinygltf::ExpandFilePath;
+        fs_callbacks.ReadWholeFile = &Model::read_mapped_file;
+        fs_callbacks.WriteWholeFile = &tinygltf::WriteWholeFile;
+        fs_callbacks.GetFileSizeInBytes = &tinygltf::GetFileSizeInBytes;
+        fs_callbacks.user_data = this;
+        gltf_context.SetFsCallbacks(fs_callbacks);
+
+        auto file = uka::Uka_Mapped_File();
+        if(!file.open(filename))
+        {
+            throw std::runtime_error("Failed to map gltf file: " + filename);
+        }
+        const auto* file_data = file.data;
+        const auto file_size = file.size;
+        // The main file is always the first mapping, external buffers follow while parsing
+        mapped_files.clear();
+        mapped_files.push_back(std::move(file));
+        binary = binary || (file_size >= 4 && memcmp(file_data, "glTF", 4) == 0);
+        if(binary)
+        {
+            file_loaded = gltf_context.LoadBinaryFromMemory(&gltf_model, &err, &warn, file_data, static_cast<unsigned int>(file_size), path);
+        }
+        else
+        {
+            file_loaded = gltf_context.LoadASCIIFromString(&gltf_model, &err, &warn, reinterpret_cast<const char*>(file_data), static_cast<unsigned int>(file_size), path);
+        }
+    }
+    else if(binary)
+    {
+        file_loaded = gltf_context.LoadBinaryFromFile(&gltf_model, &err, &warn, filename);
+    }
+    else
+    {
+        file_loaded = gltf_context.LoadASCIIFromFile(&gltf_model, &err, &warn, filename);
+    }
+    if(file_loaded)
+    {
+        bind_buffer_data(gltf_model, binary);
+    }
+
+    auto index_buffer = std::vector<uint32_t>();
+    auto vertex_buffer = std::vector<Vertex>();
+    // Point at vertex_buffer/index_buffer, or straight into the mapped geometry cache on a hit
+    const Vertex* vertex_data = nullptr;
+    const uint32_t* index_data = nullptr;
+    auto vertex_count = uint32_t{0};
+    auto index_count = uint32_t{0};
+    auto primitive_jobs = std::vector<PrimitiveLoadJob>();
+    auto geometry_cache = uka::Uka_Mapped_File();
+    auto cache_key = std::string();
+    auto cache_hit = false;
+
+    if(file_loaded)
+    {
+        if(!(file_loading_flags & uka::gltf::LoadFlags::DONT_LOAD_IMAGES))
+        {
+            load_image(gltf_model, device, transfer_queue, file_loading_flags);
+        }
+        load_materials(gltf_model);
+
+        // First pass builds the node tree and assigns every primitive its vertex/index range,
+        // second pass decodes all primitives in parallel straight into their slots
+        const auto& scene = gltf_model.scenes[gltf_model.defaultScene > -1 ? gltf_model.defaultScene : 0];
+        auto primitive_total = size_t{0};
+        for(const auto& mesh : gltf_model.meshes)
+        {
+            primitive_total += mesh.primitives.size();
+        }
+        // One block for the whole scene graph keeps it contiguous, instanced meshes spill into further blocks
+        scene_arena.reserve(gltf_model.nodes.size() * (sizeof(Node) + alignof(Node)) + gltf_model.meshes.size() * (sizeof(Mesh) + alignof(Mesh)) + primitive_total * (sizeof(Primitive) + alignof(Primitive)));
+        node_lookup.assign(gltf_model.nodes.size(), nullptr);
+        for(auto nodeIndex : scene.nodes)
+        {
+            load_node(nullptr, gltf_model.nodes[nodeIndex], nodeIndex, gltf_model, primitive_jobs, vertex_count, index_count, scale);
+        }
+        if(file_loading_flags & uka::gltf::LoadFlags::CACHE_GEOMETRY)
+        {
+            // A valid cache holds the final vertex/index blobs and primitive ranges, so decoding is skipped entirely.
+            // Buffers were already read by the parser and stay needed for skins, animations and buffer view images.
+            cache_key = geometry_cache_key(filename, gltf_model, file_loading_flags, scale);
+            cache_hit = geometry_cache.open(geometry_cache_path(filename)) && read_geometry_cache(geometry_cache, cache_key, primitive_jobs, &vertex_data, vertex_count, &index_data, index_count);
+        }
+        if(!cache_hit)
+        {
+            vertex_buffer.resize(vertex_count);
+            index_buffer.resize(index_count);
+            uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t i)
+            {
+                load_primitive(gltf_model, primitive_jobs[i], index_buffer, vertex_buffer);
+            });
+            if(file_loading_flags & LoadFlags::WELD_VERTICES)
+            {
+                weld_vertices(primitive_jobs, index_buffer, vertex_buffer);
+            }
+            if(file_loading_flags & (LoadFlags::OPTIMIZE_MESHES | LoadFlags::OPTIMIZE_OVERDRAW))
+            {
+                optimize_meshes(primitive_jobs, index_buffer, vertex_buffer, file_loading_flags & LoadFlags::OPTIMIZE_OVERDRAW);
+            }
+            if(file_loading_flags & LoadFlags::GENERATE_LODS)
+            {
+                generate_lods(primitive_jobs, index_buffer, vertex_buffer);
+            }
+        }
+        if(gltf_model.skins.size() > 0)
+        {
+            load_skins(gltf_model);
+        }
+        if(gltf_model.animations.size() > 0)
+        {
+            load_animations(gltf_model);
+        }
+        for(auto node : linear_nodes)
+        {
+            if(node->skin_index > -1)
+            {
+                node->skin = skins[node->skin_index];
+            }
+            if(node->mesh)
+            {
+                node->transform_index = static_cast<uint32_t>(mesh_transforms.size());
+                auto transform = MeshTransform{};
+                if(node->skin)
+                {
+                    node->first_joint = static_cast<uint32_t>(joint_matrices.size());
+                    transform.first_joint = node->first_joint;
+                    transform.joint_count = static_cast<uint32_t>(node->skin->joints.size());
+                    joint_matrices.resize(joint_matrices.size() + node->skin->joints.size());
+                }
+                mesh_transforms.push_back(transform);
+                for(auto primitive : node->mesh->primitives)
+                {
+                    primitive_instances.push_back({node, primitive});
+                }
+            }
+        }
+        primitive_bounds.resize(primitive_instances.size());
+        update_transforms();
+    }
+    else
+    {
         throw std::runtime_error("Failed to load gltf file: " + filename + "\n" + err);
         return;
     }
 
-    if((file_loading_flags & LoadFlags::PRE_TRANSFORM_VERTICES) || (file_loading_flags & LoadFlags::PRE_MULTIPLY_VERTEX_COLORS) ||(file_loading_flags & LoadFlags::FLIP_Y) )
+    if(!cache_hit && ((file_loading_flags & LoadFlags::PRE_TRANSFORM_VERTICES) || (file_loading_flags & LoadFlags::PRE_MULTIPLY_VERTEX_COLORS) ||(file_loading_flags & LoadFlags::FLIP_Y)))
     {
         auto pre_transform = file_loading_flags & LoadFlags::PRE_TRANSFORM_VERTICES;
         auto pre_multiply_vertex_colors = file_loading_flags & LoadFlags::PRE_MULTIPLY_VERTEX_COLORS;
@@ -1254,9 +2403,9 @@ auto uka::gltf::Model::load_form_file(std::string filename,
                 auto loacal_matrix = node->get_matrix();
                 for(auto primitive : node->mesh->primitives)
                 {
-                    for(auto i=0;i<primitive->index_count;i++)
+                    for(auto i=0;i<primitive->vertex_count;i++)
                     {
-                        auto& vertex = vertex_buffer[primitive->first_index + i];
+                        auto& vertex = vertex_buffer[primitive->first_vertex + i];
                         if(pre_transform)
                         {
                             vertex.position = loacal_matrix * glm::vec4(vertex.position,1.0);
@@ -1284,10 +2433,102 @@ auto uka::gltf::Model::load_form_file(std::string filename,
         }
     }
 
-    auto vertex_buffer_size = vertex_buffer.size() * sizeof(Vertex);
-    auto index_buffer_size = index_buffer.size() * sizeof(uint32_t);
-    indices.count = static_cast<uint32_t>(index_buffer.size());
-    vertices.count = static_cast<uint32_t>(vertex_buffer.size());
+    if(!cache_hit)
+    {
+        vertex_data = vertex_buffer.data();
+        index_data = index_buffer.data();
+        vertex_count = static_cast<uint32_t>(vertex_buffer.size());
+        index_count = static_cast<uint32_t>(index_buffer.size());
+        if(file_loading_flags & LoadFlags::CACHE_GEOMETRY)
+        {
+            geometry_cache.close();
+            write_geometry_cache(geometry_cache_path(filename), cache_key, primitive_jobs, vertex_buffer, index_buffer);
+        }
+    }
+
+    if(file_loading_flags & LoadFlags::BUILD_MESHLETS)
+    {
+        build_meshlets(primitive_jobs, vertex_data, index_data);
+    }
+
+    auto packed_vertices = std::vector<unsigned char>();
+    const void* vertex_upload = vertex_data;
+    auto vertex_buffer_size = size_t{vertex_count} * sizeof(Vertex);
+    vertices.split_streams = file_loading_flags & LoadFlags::SPLIT_VERTEX_STREAMS;
+    if(vertex_compression_flags & COMPRESS_JOINTS_UINT8)
+    {
+        // Joint indices address the node's skin. The vertex input helpers follow the global vertex_compression,
+        // so a skin too large for 8 bits fails the load instead of silently switching formats.
+        auto wide_joints = std::any_of(linear_nodes.begin(), linear_nodes.end(), [](const Node* node) { return node->mesh && node->skin && node->skin->joints.size() > 256; });
+        if(wide_joints)
+        {
+            throw std::runtime_error("COMPRESS_JOINTS_UINT8 needs skins of at most 256 joints, use COMPRESS_JOINTS_UINT16: " + filename);
+        }
+    }
+    if(vertex_compression_flags != COMPRESS_NONE || vertices.split_streams)
+    {
+        const auto vertex_layout = Vertex::layout(vertex_compression_flags, vertices.split_streams);
+        packed_vertices = pack_vertices(vertex_data, vertex_count, primitive_jobs, vertex_layout);
+        vertex_upload = packed_vertices.data();
+        vertex_buffer_size = packed_vertices.size();
+        for(auto stream = 1; stream < 3; stream++)
+        {
+            vertices.stream_offsets[stream] = vertices.stream_offsets[stream - 1] + VkDeviceSize{vertex_count} * vertex_layout.stream_strides[stream - 1];
+        }
+    }
+    // Skinned primitives get consecutive slots in the skinning output, the compute pass reads the interleaved source vertices
+    auto skinning_usage = VkBufferUsageFlags{0};
+    // Packed vertices leave skinning.vertex_count at 0, skinning then stays in the vertex shader
+    if((file_loading_flags & LoadFlags::GPU_SKINNING) && !joint_matrices.empty() && vertex_upload == vertex_data)
+    {
+        for(auto node : linear_nodes)
+        {
+            if(node->mesh && node->skin)
+            {
+                for(auto primitive : node->mesh->primitives)
+                {
+                    primitive->skinned_vertex_offset = static_cast<int32_t>(skinning.vertex_count) - static_cast<int32_t>(primitive->first_vertex);
+                    skinning.vertex_count += primitive->vertex_count;
+                }
+            }
+        }
+        skinning_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
+    auto index_buffer_size = size_t{index_count} * sizeof(uint32_t);
+    const void* index_upload = index_data;
+    auto index_buffer_16 = std::vector<uint16_t>();
+    indices.type = VK_INDEX_TYPE_UINT32;
+    if(file_loading_flags & (LoadFlags::OPTIMIZE_MESHES | LoadFlags::OPTIMIZE_OVERDRAW))
+    {
+        // Indices relative to the primitive plus a vertex offset at draw time fit 16 bits if every primitive does
+        auto fits_16_bit = std::all_of(primitive_jobs.begin(), primitive_jobs.end(), [](const PrimitiveLoadJob& job) { return job.primitive->vertex_count <= 65536; });
+        if(fits_16_bit)
+        {
+            index_buffer_16.resize(index_count);
+            uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(primitive_jobs.size()), [&](uint32_t p)
+            {
+                auto* primitive = primitive_jobs[p].primitive;
+                primitive->vertex_offset = static_cast<int32_t>(primitive->first_vertex);
+                auto convert = [&](uint32_t first_index, uint32_t count)
+                {
+                    for(auto i = first_index; i < first_index + count; i++)
+                    {
+                        index_buffer_16[i] = static_cast<uint16_t>(index_data[i] - primitive->first_vertex);
+                    }
+                };
+                convert(primitive->first_index, primitive->index_count);
+                for(const auto& lod : primitive->lods)
+                {
+                    convert(lod.first_index, lod.index_count);
+                }
+            });
+            index_upload = index_buffer_16.data();
+            index_buffer_size = index_buffer_16.size() * sizeof(uint16_t);
+            indices.type = VK_INDEX_TYPE_UINT16;
+        }
+    }
+    indices.count = static_cast<int>(index_count);
+    vertices.count = static_cast<int>(vertex_count);
     assert(vertex_buffer_size > 0);
     assert(index_buffer_size > 0);
 
@@ -1297,9 +2538,13 @@ auto uka::gltf::Model::load_form_file(std::string filename,
         VkDeviceMemory memory;
     } vertexStaging, indexStaging;
 
-    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertex_buffer_size, &vertexStaging.buffer, &vertexStaging.memory, vertex_buffer.data()));
-    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, index_buffer_size, &indexStaging.buffer, &indexStaging.memory, index_buffer.data()));
-    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | memory_property_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer_size, &vertices.buffer, &vertices.memory));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertex_buffer_size, &vertexStaging.buffer, &vertexStaging.memory, const_cast<void*>(vertex_upload)));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, index_buffer_size, &indexStaging.buffer, &indexStaging.memory, const_cast<void*>(index_upload)));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | skinning_usage | memory_property_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer_size, &vertices.buffer, &vertices.memory));
+    if(skinning.vertex_count > 0)
+    {
+        VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | memory_property_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkDeviceSize{skinning.vertex_count} * sizeof(Vertex), &skinning.output, &skinning.output_memory));
+    }
     VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | memory_property_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer_size, &indices.buffer, &indices.memory));
 
     auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -1313,18 +2558,28 @@ auto uka::gltf::Model::load_form_file(std::string filename,
     vkFreeMemory(device->logical_device, vertexStaging.memory, nullptr);
     vkDestroyBuffer(device->logical_device, indexStaging.buffer, nullptr);
     vkFreeMemory(device->logical_device, indexStaging.memory, nullptr);
+    buffer_data.clear();
+    mapped_files.clear();
+    geometry_cache.close();
 
     get_scene_dimensions();
 
-    auto ubo_count = uint32_t{0};
-    auto image_count = uint32_t{0};
-    for(auto node : linear_nodes)
+    // One buffer for every mesh transform and joint matrix, a range per frame in flight
+    const auto alignment = std::max<VkDeviceSize>(device->properties.limits.minStorageBufferOffsetAlignment, 1);
+    auto align = [&](VkDeviceSize size) { return (size + alignment - 1) / alignment * alignment; };
+    const auto transforms_size = std::max<size_t>(mesh_transforms.size(), 1) * sizeof(MeshTransform);
+    const auto joints_size = std::max<size_t>(joint_matrices.size(), 1) * sizeof(glm::mat4);
+    transforms.joints_offset = align(transforms_size);
+    transforms.frame_size = align(transforms.joints_offset + joints_size);
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, transforms.frame_size * frames_in_flight, &transforms.buffer, &transforms.memory));
+    VK_CHECK_RESULT(vkMapMemory(device->logical_device, transforms.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&transforms.mapped)));
+    transforms.uploaded_generation.assign(frames_in_flight, 0);
+    for(auto frame = uint32_t{0}; frame < frames_in_flight; frame++)
     {
-        if(node->mesh)
-        {
-            ubo_count++;
-        }
+        upload_transforms(frame);
     }
+
+    auto image_count = uint32_t{0};
     for(auto material : materials)
     {
         if(material.base_color_texture)
@@ -1332,48 +2587,74 @@ auto uka::gltf::Model::load_form_file(std::string filename,
             image_count++;
         }
     }
+    const auto bindless_materials = (file_loading_flags & LoadFlags::BINDLESS_MATERIALS) != 0;
     std::vector<VkDescriptorPoolSize> pool_sizes = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ubo_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
     };
+    // Bindless sets come from their own update after bind pool, see prepare_bindless
+    if(bindless_materials)
+    {
+        image_count = 0;
+    }
+    // A streaming swap allocates a material's new set while the replaced ones may be pending for frames_in_flight updates
+    const auto material_set_copies = texture_streaming.batch ? 1 + frames_in_flight : 1;
     if(image_count > 0)
     {
         if(descriptor_binding_flags & DescriptorBindingFlags::image_base_color)
         {
-            pool_sizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_count});
+            pool_sizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_count * material_set_copies});
         }
         if(descriptor_binding_flags & DescriptorBindingFlags::image_normal_map)
         {
-            pool_sizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_count});
+            pool_sizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_count * material_set_copies});
         }
     }
 
     auto desciptor_pool_create_info = VkDescriptorPoolCreateInfo{};
     desciptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    desciptor_pool_create_info.flags = material_set_copies > 1 ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
     desciptor_pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
     desciptor_pool_create_info.pPoolSizes = pool_sizes.data();
-    desciptor_pool_create_info.maxSets = ubo_count + image_count;
+    desciptor_pool_create_info.maxSets = 1 + image_count * material_set_copies;
     VK_CHECK_RESULT(vkCreateDescriptorPool(device->logical_device, &desciptor_pool_create_info, nullptr, &descriptor_pool));
 
-    if(descriptor_set_layout_ubo == VK_NULL_HANDLE)
+    if(descriptor_set_layout_transforms == VK_NULL_HANDLE)
     {
         std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
-           uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+           uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0),
+           uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1),
+           uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 2),
         };
         auto desciptor_pool_create_info = VkDescriptorSetLayoutCreateInfo{};
         desciptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         desciptor_pool_create_info.bindingCount = static_cast<uint32_t>(set_layout_bindings.size());
         desciptor_pool_create_info.pBindings = set_layout_bindings.data();
-        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &desciptor_pool_create_info, nullptr, &descriptor_set_layout_ubo));
-        for (auto node : nodes) {
-            prepare_node_descriptor_set(node, descriptor_set_layout_ubo);
-        }
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &desciptor_pool_create_info, nullptr, &descriptor_set_layout_transforms));
+    }
+    {
+        auto allocate_info = uka::init::descriptor_set_allocate_info(descriptor_pool, 1, &descriptor_set_layout_transforms);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &allocate_info, &transforms.descriptor_set));
+        // Dynamic offsets select the frame's range
+        auto transforms_info = VkDescriptorBufferInfo{transforms.buffer, 0, transforms_size};
+        auto joints_info = VkDescriptorBufferInfo{transforms.buffer, transforms.joints_offset, joints_size};
+        std::vector<VkWriteDescriptorSet> writes = {
+            uka::init::write_descriptor_set(transforms.descriptor_set, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &transforms_info),
+            uka::init::write_descriptor_set(transforms.descriptor_set, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &joints_info),
+        };
+        vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+    if(bindless_materials)
+    {
+        prepare_bindless(transfer_queue);
+        return;
     }
     if (descriptor_set_layout_image == VK_NULL_HANDLE) {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
         if (descriptor_binding_flags & DescriptorBindingFlags::image_base_color) {
             setLayoutBindings.push_back(uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
         }
-        if (descriptor_binding_flags & DescriptorBindingFlags::image_base_color) {
+        if (descriptor_binding_flags & DescriptorBindingFlags::image_normal_map) {
             setLayoutBindings.push_back(uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
         }
         VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
@@ -1381,25 +2662,376 @@ auto uka::gltf::Model::load_form_file(std::string filename,
         descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorLayoutCI.pBindings = setLayoutBindings.data();
         VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &descriptorLayoutCI, nullptr, &descriptor_set_layout_image));
-
-        for (auto& material : materials)
-        {
-            if (material.base_color_texture != nullptr)
+    }
+    // Every model needs its own sets, not only the one that created the shared layout
+    for (auto& material : materials)
+    {
+        if (material.base_color_texture != nullptr)
+        {
+            material.create_descriptor_set(descriptor_pool, descriptor_set_layout_image, descriptor_binding_flags);
+        }
+    }
+}
+
+auto uka::gltf::Model::prepare_bindless(VkQueue transfer_queue) -> void
+{
+    if(descriptor_set_layout_bindless == VK_NULL_HANDLE)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
+            uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+            uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, max_bindless_textures),
+        };
+        // Models size the image array to their texture count, unused elements stay unwritten. Texture streaming
+        // rewrites elements while earlier frames using the set are still pending.
+        const VkDescriptorBindingFlags binding_flags[2] = {
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+        };
+        auto binding_flags_create_info = VkDescriptorSetLayoutBindingFlagsCreateInfo{};
+        binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        binding_flags_create_info.bindingCount = 2;
+        binding_flags_create_info.pBindingFlags = binding_flags;
+        auto set_layout_create_info = uka::init::descriptor_set_layout_create_info(set_layout_bindings);
+        set_layout_create_info.pNext = &binding_flags_create_info;
+        set_layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &set_layout_create_info, nullptr, &descriptor_set_layout_bindless));
+    }
+    bindless.texture_count = static_cast<uint32_t>(textures.size()) + 1;
+    if(bindless.texture_count > max_bindless_textures)
+    {
+        throw std::runtime_error("Model has more textures than max_bindless_textures");
+    }
+
+    auto texture_index = [&](const Texture* texture) -> int32_t
+    {
+        if(texture == nullptr)
+        {
+            return -1;
+        }
+        if(texture == &empty_texture)
+        {
+            return static_cast<int32_t>(textures.size());
+        }
+        return static_cast<int32_t>(texture - textures.data());
+    };
+    std::vector<MaterialData> material_data(materials.size());
+    for(auto i = size_t{0}; i < materials.size(); i++)
+    {
+        const auto& material = materials[i];
+        auto& data = material_data[i];
+        data.base_color_factor = material.base_color_factor;
+        data.metallic_factor = material.metallic_factor;
+        data.roughness_factor = material.roughness_factor;
+        data.alpha_cutoff = material.alpha_cutoff;
+        data.alpha_mode = static_cast<uint32_t>(material.alpha_mode);
+        data.base_color_texture = texture_index(material.base_color_texture);
+        data.metallic_roughness_texture = texture_index(material.metallic_roughness_texture);
+        data.normal_texture = texture_index(material.normal_texture);
+        data.occlusion_texture = texture_index(material.occlusion_texture);
+        data.emissive_texture = texture_index(material.emissive_texture);
+    }
+    const auto materials_size = material_data.size() * sizeof(MaterialData);
+    auto staging_buffer = VkBuffer{};
+    auto staging_memory = VkDeviceMemory{};
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, materials_size, &staging_buffer, &staging_memory, material_data.data()));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, materials_size, &bindless.materials, &bindless.memory));
+    auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    auto copy_region = VkBufferCopy{};
+    copy_region.size = materials_size;
+    vkCmdCopyBuffer(copy_cmd, staging_buffer, bindless.materials, 1, &copy_region);
+    device->flush_command_buffer(copy_cmd, transfer_queue);
+    vkDestroyBuffer(device->logical_device, staging_buffer, nullptr);
+    vkFreeMemory(device->logical_device, staging_memory, nullptr);
+
+    auto variable_count_info = VkDescriptorSetVariableDescriptorCountAllocateInfo{};
+    variable_count_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    variable_count_info.descriptorSetCount = 1;
+    variable_count_info.pDescriptorCounts = &bindless.texture_count;
+    std::vector<VkDescriptorPoolSize> pool_sizes = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindless.texture_count },
+    };
+    auto pool_create_info = uka::init::descriptor_pool_create_info(pool_sizes, 1);
+    pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device->logical_device, &pool_create_info, nullptr, &bindless.descriptor_pool));
+    auto allocate_info = uka::init::descriptor_set_allocate_info(bindless.descriptor_pool, 1, &descriptor_set_layout_bindless);
+    allocate_info.pNext = &variable_count_info;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &allocate_info, &bindless.descriptor_set));
+
+    std::vector<VkDescriptorImageInfo> image_infos;
+    image_infos.reserve(bindless.texture_count);
+    for(const auto& texture : textures)
+    {
+        image_infos.push_back(texture.descriptor);
+    }
+    image_infos.push_back(empty_texture.descriptor);
+    auto materials_info = VkDescriptorBufferInfo{bindless.materials, 0, materials_size};
+    std::vector<VkWriteDescriptorSet> writes = {
+        uka::init::write_descriptor_set(bindless.descriptor_set, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &materials_info),
+        uka::init::write_descriptor_set(bindless.descriptor_set, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_infos.data(), bindless.texture_count),
+    };
+    vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+auto uka::gltf::Model::material_descriptor_set(uint32_t material_index) const -> VkDescriptorSet
+{
+    return bindless.descriptor_set != VK_NULL_HANDLE ? bindless.descriptor_set : materials[material_index].descriptor_set;
+}
+
+auto uka::gltf::Model::update_texture_streaming() -> bool
+{
+    auto& streaming = texture_streaming;
+    streaming.update_count++;
+    // Command buffers of the last frames_in_flight updates may still use retired views and sets
+    auto expired = [&](const TextureStreaming::Retired& retired) { return retired.update + frames_in_flight <= streaming.update_count; };
+    for(const auto& retired : streaming.retired)
+    {
+        if(!expired(retired))
+        {
+            continue;
+        }
+        if(retired.image_view != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(device->logical_device, retired.image_view, nullptr);
+        }
+        if(retired.descriptor_set != VK_NULL_HANDLE)
+        {
+            VK_CHECK_RESULT(vkFreeDescriptorSets(device->logical_device, descriptor_pool, 1, &retired.descriptor_set));
+        }
+    }
+    streaming.retired.erase(std::remove_if(streaming.retired.begin(), streaming.retired.end(), expired), streaming.retired.end());
+    if(!streaming.batch)
+    {
+        return !streaming.retired.empty();
+    }
+    if(!streaming.batch->finished())
+    {
+        return true;
+    }
+    streaming.batch->destroy();
+
+    // Swap the finished levels into new views. Pending frames keep the old views and descriptors: bindless
+    // elements are update after bind, material sets are replaced by freshly written ones.
+    if(!streaming.in_flight.empty())
+    {
+        auto changed = std::vector<bool>(textures.size(), false);
+        for(const auto& [texture_index, level] : streaming.in_flight)
+        {
+            auto& texture = textures[texture_index];
+            streaming.retired.push_back({texture.image_view, VK_NULL_HANDLE, streaming.update_count});
+            texture.resident_level = level;
+            texture.create_view();
+            changed[texture_index] = true;
+        }
+        auto is_changed = [&](const Texture* texture)
+        {
+            return texture != nullptr && texture != &empty_texture && changed[texture - textures.data()];
+        };
+        if(bindless.descriptor_set != VK_NULL_HANDLE)
+        {
+            auto writes = std::vector<VkWriteDescriptorSet>();
+            for(const auto& [texture_index, level] : streaming.in_flight)
             {
-                material.create_descriptor_set(descriptor_pool, descriptor_set_layout_image, descriptor_binding_flags);
+                (void)level;
+                writes.push_back(uka::init::write_descriptor_set(bindless.descriptor_set, 1, texture_index, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &textures[texture_index].descriptor));
+            }
+            vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+        else
+        {
+            for(auto& material : materials)
+            {
+                if(material.descriptor_set != VK_NULL_HANDLE && (is_changed(material.base_color_texture) || is_changed(material.normal_texture)))
+                {
+                    streaming.retired.push_back({VK_NULL_HANDLE, material.descriptor_set, streaming.update_count});
+                    material.create_descriptor_set(descriptor_pool, descriptor_set_layout_image, descriptor_binding_flags);
+                }
             }
         }
+        streaming.in_flight.clear();
+        streaming.sources.erase(std::remove_if(streaming.sources.begin(), streaming.sources.end(), [&](const TextureStreaming::Source& source) { return textures[source.texture].resident_level == 0; }), streaming.sources.end());
     }
+
+    if(streaming.sources.empty())
+    {
+        streaming.batch.reset();
+        vkDestroyCommandPool(device->logical_device, streaming.command_pool, nullptr);
+        streaming.command_pool = VK_NULL_HANDLE;
+        return !streaming.retired.empty();
+    }
+
+    // The next larger level of every streaming texture, up to the batch budget
+    auto staging_size = VkDeviceSize{0};
+    for(const auto& source : streaming.sources)
+    {
+        const auto level = textures[source.texture].resident_level - 1;
+        const auto level_size = source.level_offsets[level + 1] - source.level_offsets[level];
+        if(!streaming.in_flight.empty() && staging_size + level_size > streaming_batch_size)
+        {
+            break;
+        }
+        staging_size += level_size + 16;
+        streaming.in_flight.push_back({source.texture, level});
+    }
+    auto& batch = *streaming.batch;
+    batch.begin(staging_size);
+    for(auto i = size_t{0}; i < streaming.in_flight.size(); i++)
+    {
+        const auto& source = streaming.sources[i];
+        const auto& texture = textures[source.texture];
+        const auto level = streaming.in_flight[i].second;
+        const auto level_size = source.level_offsets[level + 1] - source.level_offsets[level];
+        auto stage_offset = VkDeviceSize{};
+        memcpy(batch.allocate(level_size, 16, stage_offset), source.data.data() + source.level_offsets[level], level_size);
+
+        // The transfer queue cannot wait on shader stages, the swap happens after the fence anyway
+        auto barrier = uka::init::image_memory_barrier();
+        barrier.image = texture.image;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        auto buffer_image_copy = VkBufferImageCopy{};
+        buffer_image_copy.bufferOffset = stage_offset;
+        buffer_image_copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        buffer_image_copy.imageExtent = {std::max(1u, texture.width >> level), std::max(1u, texture.height >> level), 1};
+        vkCmdCopyBufferToImage(batch.command_buffer, batch.staging_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_image_copy);
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    batch.submit_async(streaming.queue);
+    return true;
 }
 
-auto uka::gltf::Model::bind_buffers(VkCommandBuffer commandbuffer) -> void
+auto uka::gltf::Model::bind_buffers(VkCommandBuffer commandbuffer, uint32_t vertex_streams) -> void
 {
-    const VkDeviceSize offsets[1] = { 0 };
-    vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
-    vkCmdBindIndexBuffer(commandbuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+    if(vertices.split_streams)
+    {
+        // Only the streams the pipeline declares, a depth-only pass fetches positions and nothing else
+        for(auto stream = uint32_t{0}; stream < 3; stream++)
+        {
+            if(vertex_streams & (1u << stream))
+            {
+                vkCmdBindVertexBuffers(commandbuffer, stream, 1, &vertices.buffer, &vertices.stream_offsets[stream]);
+            }
+        }
+    }
+    else
+    {
+        const VkDeviceSize offsets[1] = { 0 };
+        vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
+    }
+    vkCmdBindIndexBuffer(commandbuffer, indices.buffer, 0, indices.type);
     buffers_bound = true;
 }
 
+auto uka::gltf::Model::select_lod(const glm::mat4& world_matrix, const Primitive* primitive) const -> const Primitive::Lod*
+{
+    if(primitive->lods.empty())
+    {
+        return nullptr;
+    }
+    const auto normal_matrix = glm::mat3(world_matrix);
+    const auto scale = std::max(glm::length(normal_matrix[0]), std::max(glm::length(normal_matrix[1]), glm::length(normal_matrix[2])));
+    auto center = glm::vec3(world_matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+    auto radius = primitive->dimensions.radius * scale;
+    // Distance to the nearest point of the bounding sphere, inside it the full mesh is always used
+    auto distance = glm::length(center - lod_selection->eye) - radius;
+    if(distance <= 0.0f)
+    {
+        return nullptr;
+    }
+    const auto pixels_per_unit = lod_selection->pixels_per_unit * scale / distance;
+    const Primitive::Lod* selected = nullptr;
+    for(const auto& lod : primitive->lods)
+    {
+        if(lod.error * pixels_per_unit > lod_selection->pixel_error)
+        {
+            break;
+        }
+        selected = &lod;
+    }
+    return selected;
+}
+
+auto uka::gltf::Model::draw_primitive(const Node* node,
+    const Primitive* primitive,
+    VkCommandBuffer commandbuffer) -> void
+{
+    const auto& world_matrix = node->world_matrix;
+    const auto skinned = node->skin && skinning.pipeline != VK_NULL_HANDLE;
+    const auto vertex_offset = primitive->vertex_offset + (skinned ? primitive->skinned_vertex_offset : 0);
+    if(lod_selection)
+    {
+        if(auto lod = select_lod(world_matrix, primitive))
+        {
+            vkCmdDrawIndexed(commandbuffer, lod->index_count, 1, lod->first_index, vertex_offset, 0);
+            return;
+        }
+    }
+    // Meshlet bounds are bind pose, so skinned nodes are always drawn whole like their unbounded culling boxes
+    if(!meshlet_culling || primitive->meshlet_count == 0 || node->skin)
+    {
+        vkCmdDrawIndexed(commandbuffer, primitive->index_count, 1, primitive->first_index, vertex_offset, 0);
+        return;
+    }
+    const auto& frustum = meshlet_culling->frustum;
+    const auto& eye = meshlet_culling->eye;
+    const auto normal_matrix = glm::mat3(world_matrix);
+    const auto scale = std::max(glm::length(normal_matrix[0]), std::max(glm::length(normal_matrix[1]), glm::length(normal_matrix[2])));
+    // Cone axes are normal directions, non-uniform scale needs the inverse transpose to keep them perpendicular to the surface
+    const auto cone_matrix = glm::transpose(glm::inverse(normal_matrix));
+
+    // Meshlets are consecutive index ranges, so neighbouring survivors merge into one draw
+    auto run_first = uint32_t{0};
+    auto run_count = uint32_t{0};
+    for(auto m = primitive->first_meshlet; m < primitive->first_meshlet + primitive->meshlet_count; m++)
+    {
+        const auto& meshlet = meshlets[m];
+        auto center = glm::vec3(world_matrix * glm::vec4(glm::make_vec3(meshlet.center), 1.0f));
+        auto radius = meshlet.radius * scale;
+        auto visible = frustum.sphere_visible(center, radius);
+        if(!visible)
+        {
+            culling_statistics.frustum_culled++;
+        }
+        else
+        {
+            auto axis = glm::normalize(cone_matrix * glm::make_vec3(meshlet.cone_axis));
+            auto view = center - eye;
+            if(glm::dot(view, axis) >= meshlet.cone_cutoff * glm::length(view) + radius)
+            {
+                culling_statistics.backface_culled++;
+                visible = false;
+            }
+        }
+        if(visible)
+        {
+            culling_statistics.visible++;
+            if(run_count > 0 && run_first + run_count == meshlet.first_index)
+            {
+                run_count += meshlet.triangle_count * 3;
+                continue;
+            }
+            if(run_count > 0)
+            {
+                vkCmdDrawIndexed(commandbuffer, run_count, 1, run_first, vertex_offset, 0);
+            }
+            run_first = meshlet.first_index;
+            run_count = meshlet.triangle_count * 3;
+        }
+    }
+    if(run_count > 0)
+    {
+        vkCmdDrawIndexed(commandbuffer, run_count, 1, run_first, vertex_offset, 0);
+    }
+}
+
 auto uka::gltf::Model::draw_node(uka::gltf::Node* node,
     VkCommandBuffer commandbuffer,
     uint32_t render_flags,
@@ -1408,10 +3040,17 @@ auto uka::gltf::Model::draw_node(uka::gltf::Node* node,
 {
     if(node->mesh)
     {
+        // Skinned nodes draw from the compute pre-pass output, which shares the interleaved layout
+        const auto skinned = node->skin && skinning.pipeline != VK_NULL_HANDLE;
+        const VkDeviceSize offsets[1] = { 0 };
+        if(skinned)
+        {
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, &skinning.output, offsets);
+        }
         for(auto primitive :node->mesh->primitives)
         {
             bool skip = false;
-            const auto material = primitive->material;
+            const auto& material = materials[primitive->material_index];
             if (render_flags & VkRenderingFlags::RENDER_OPAQUE_NODES) {
                 skip = (material.alpha_mode != Material::APLHA_OPAQUE);
             }
@@ -1423,11 +3062,25 @@ auto uka::gltf::Model::draw_node(uka::gltf::Node* node,
             }
             if (!skip) {
                 if (render_flags & VkRenderingFlags::BIND_IMAGES) {
-                    vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, bind_image_set, 1, &material.descriptor_set, 0, nullptr);
+                    const auto descriptor_set = material_descriptor_set(primitive->material_index);
+                    vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, bind_image_set, 1, &descriptor_set, 0, nullptr);
+                }
+                if ((render_flags & VkRenderingFlags::PUSH_POSITION_DEQUANTIZATION) && pipeline_layout != VK_NULL_HANDLE) {
+                    vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Primitive::Dequantization), &primitive->dequantization);
                 }
-                vkCmdDrawIndexed(commandbuffer, primitive->index_count, 1, primitive->first_index, 0, 0);
+                if ((render_flags & VkRenderingFlags::PUSH_TRANSFORM_INDEX) && pipeline_layout != VK_NULL_HANDLE) {
+                    vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(Primitive::Dequantization), sizeof(uint32_t), &node->transform_index);
+                }
+                if ((render_flags & VkRenderingFlags::PUSH_MATERIAL_INDEX) && pipeline_layout != VK_NULL_HANDLE) {
+                    vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Primitive::Dequantization) + sizeof(uint32_t), sizeof(uint32_t), &primitive->material_index);
+                }
+                draw_primitive(node, primitive, commandbuffer);
             }
         }
+        if(skinned)
+        {
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
+        }
     }
     for(auto& child : node->children)
     {
@@ -1438,28 +3091,206 @@ auto uka::gltf::Model::draw_node(uka::gltf::Node* node,
 auto uka::gltf::Model::draw(VkCommandBuffer commandbuffer,
     uint32_t render_flags,
     VkPipelineLayout pipeline_layout,
-    uint32_t bind_image_set) -> void
+    uint32_t bind_image_set,
+    uint32_t vertex_streams) -> void
+{
+    // Depth only orders draws within a material here, so any eye will do when the caller has none
+    auto eye = glm::vec3(0.0f);
+    const uka::Uka_Frustum* frustum = nullptr;
+    if(meshlet_culling)
+    {
+        // Whole primitives outside the frustum are dropped before their meshlets are looked at
+        eye = meshlet_culling->eye;
+        frustum = &meshlet_culling->frustum;
+    }
+    else if(lod_selection)
+    {
+        eye = lod_selection->eye;
+    }
+    build_render_queue(render_queue, eye, render_flags, frustum);
+    draw_queue(commandbuffer, render_queue, render_flags, pipeline_layout, bind_image_set, vertex_streams);
+}
+
+// Positive floats order like their bit patterns
+static auto depth_bits(float depth) -> uint64_t
+{
+    auto bits = uint32_t{0};
+    depth = std::max(depth, 0.0f);
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+auto uka::gltf::Model::build_render_queue(RenderQueue& queue,
+    const glm::vec3& eye,
+    uint32_t render_flags,
+    const uka::Uka_Frustum* frustum) const -> void
+{
+    const auto alpha_filter = render_flags & (RENDER_OPAQUE_NODES | RENDER_ALPHA_MASKED_NODES | RENDER_ALPHA_BLENDED_NODES);
+    const uint32_t alpha_flags[3] = { RENDER_OPAQUE_NODES, RENDER_ALPHA_MASKED_NODES, RENDER_ALPHA_BLENDED_NODES };
+    queue.packets.clear();
+    queue.culling = uka::culling::Statistics{};
+    if(frustum)
+    {
+        cull(*frustum, queue.visibility);
+    }
+    for(auto i = size_t{0}; i < primitive_instances.size(); i++)
+    {
+        const auto* node = primitive_instances[i].node;
+        const auto* primitive = primitive_instances[i].primitive;
+        const auto& material = materials[primitive->material_index];
+        const auto alpha_mode = static_cast<uint32_t>(material.alpha_mode);
+        assert(alpha_mode <= Material::APLHA_BLEND);
+        if(alpha_filter && !(alpha_filter & alpha_flags[alpha_mode]))
+        {
+            continue;
+        }
+        if(frustum && !queue.visibility[i])
+        {
+            queue.culling.culled++;
+            continue;
+        }
+        queue.culling.visible++;
+        const auto skinned = node->skin && skinning.pipeline != VK_NULL_HANDLE;
+        auto center = glm::vec3(node->world_matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+        // [63:62] alpha mode, [61] skinned, then 24 bits material and 32 bits depth below it,
+        // with depth above material and inverted for blended primitives
+        const auto depth = depth_bits(glm::length(center - eye));
+        const auto material_bits = static_cast<uint64_t>(primitive->material_index & 0xffffff);
+        auto key = (static_cast<uint64_t>(alpha_mode) << 62) | (static_cast<uint64_t>(skinned) << 61);
+        if(material.alpha_mode == Material::APLHA_BLEND)
+        {
+            key |= ((~depth & 0xffffffffull) << 29) | (material_bits << 5);
+        }
+        else
+        {
+            key |= (material_bits << 37) | (depth << 5);
+        }
+        queue.packets.push_back(DrawPacket{key, node, primitive});
+    }
+    uka::radix_sort(queue.packets, queue.scratch);
+}
+
+auto uka::gltf::Model::cull(const uka::Uka_Frustum& frustum, std::vector<uint8_t>& visibility) const -> uka::culling::Statistics
+{
+    visibility.resize(primitive_instances.size());
+    return uka::culling::frustum_cull(glm::value_ptr(frustum.planes[0]), primitive_bounds, visibility.data());
+}
+
+auto uka::gltf::Model::draw_queue(VkCommandBuffer commandbuffer,
+    RenderQueue& queue,
+    uint32_t render_flags,
+    VkPipelineLayout pipeline_layout,
+    uint32_t bind_image_set,
+    uint32_t vertex_streams) -> void
 {
     if(!buffers_bound)
     {
-        const VkDeviceSize offsets[1] = {0};
-        vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(commandbuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+        bind_buffers(commandbuffer, vertex_streams);
+        buffers_bound = false;
+    }
+    queue.draws = 0;
+    queue.descriptor_binds = 0;
+    queue.vertex_buffer_binds = 0;
+    queue.push_constants = 0;
+    const auto push_constants = pipeline_layout != VK_NULL_HANDLE;
+    const VkDeviceSize offsets[1] = { 0 };
+    VkDescriptorSet bound_set = VK_NULL_HANDLE;
+    auto set_bound = false;
+    auto skinned_bound = false;
+    const Primitive* pushed_primitive = nullptr;
+    const Node* pushed_node = nullptr;
+    auto pushed_material = std::numeric_limits<uint32_t>::max();
+    for(const auto& packet : queue.packets)
+    {
+        const auto* node = packet.node;
+        const auto* primitive = packet.primitive;
+        // Skinned nodes draw from the compute pre-pass output, which shares the interleaved layout
+        const auto skinned = node->skin && skinning.pipeline != VK_NULL_HANDLE;
+        if(skinned != skinned_bound)
+        {
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, skinned ? &skinning.output : &vertices.buffer, offsets);
+            skinned_bound = skinned;
+            queue.vertex_buffer_binds++;
+        }
+        if(render_flags & VkRenderingFlags::BIND_IMAGES)
+        {
+            const auto descriptor_set = material_descriptor_set(primitive->material_index);
+            if(!set_bound || descriptor_set != bound_set)
+            {
+                vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, bind_image_set, 1, &descriptor_set, 0, nullptr);
+                bound_set = descriptor_set;
+                set_bound = true;
+                queue.descriptor_binds++;
+            }
+        }
+        if((render_flags & VkRenderingFlags::PUSH_POSITION_DEQUANTIZATION) && push_constants && primitive != pushed_primitive)
+        {
+            vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Primitive::Dequantization), &primitive->dequantization);
+            pushed_primitive = primitive;
+            queue.push_constants++;
+        }
+        if((render_flags & VkRenderingFlags::PUSH_TRANSFORM_INDEX) && push_constants && node != pushed_node)
+        {
+            vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(Primitive::Dequantization), sizeof(uint32_t), &node->transform_index);
+            pushed_node = node;
+            queue.push_constants++;
+        }
+        if((render_flags & VkRenderingFlags::PUSH_MATERIAL_INDEX) && push_constants && primitive->material_index != pushed_material)
+        {
+            vkCmdPushConstants(commandbuffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Primitive::Dequantization) + sizeof(uint32_t), sizeof(uint32_t), &primitive->material_index);
+            pushed_material = primitive->material_index;
+            queue.push_constants++;
+        }
+        draw_primitive(node, primitive, commandbuffer);
+        queue.draws++;
     }
-    for(auto& node :nodes)
+    if(skinned_bound)
     {
-        draw_node(node, commandbuffer, render_flags, pipeline_layout, bind_image_set);
+        vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
+        queue.vertex_buffer_binds++;
     }
 }
 
+auto uka::gltf::Model::draw_lod(VkCommandBuffer commandbuffer,
+    const glm::vec3& eye,
+    const glm::mat4& projection,
+    float viewport_height,
+    float pixel_error,
+    uint32_t render_flags,
+    VkPipelineLayout pipeline_layout,
+    uint32_t bind_image_set,
+    uint32_t vertex_streams) -> void
+{
+    // projection[1][1] is cot(fov / 2), flipped projections store it negated
+    auto selection = LodSelection{eye, std::abs(projection[1][1]) * viewport_height * 0.5f, pixel_error};
+    lod_selection = &selection;
+    draw(commandbuffer, render_flags, pipeline_layout, bind_image_set, vertex_streams);
+    lod_selection = nullptr;
+}
+
+auto uka::gltf::Model::draw_culled(VkCommandBuffer commandbuffer,
+    const uka::Uka_Frustum& frustum,
+    const glm::vec3& eye,
+    uint32_t render_flags,
+    VkPipelineLayout pipeline_layout,
+    uint32_t bind_image_set,
+    uint32_t vertex_streams) -> void
+{
+    auto culling = MeshletCulling{frustum, eye};
+    culling_statistics = CullingStatistics{};
+    meshlet_culling = &culling;
+    draw(commandbuffer, render_flags, pipeline_layout, bind_image_set, vertex_streams);
+    meshlet_culling = nullptr;
+}
+
 auto uka::gltf::Model::get_node_dimensions(uka::gltf::Node* node, glm::vec3& min, glm::vec3& max) -> void
 {
     if(node->mesh)
     {
         for(auto primitive : node->mesh->primitives)
         {
-            glm::vec4 loc_min = glm::vec4(primitive->dimensions.min, 1.0f) * node->get_matrix();
-            glm::vec4 loc_max = glm::vec4(primitive->dimensions.max, 1.0f) * node->get_matrix();
+            glm::vec4 loc_min = glm::vec4(primitive->dimensions.min, 1.0f) * node->world_matrix;
+            glm::vec4 loc_max = glm::vec4(primitive->dimensions.max, 1.0f) * node->world_matrix;
             if (loc_min.x < min.x) { min.x = loc_min.x; }
             if (loc_min.y < min.y) { min.y = loc_min.y; }
             if (loc_min.z < min.z) { min.z = loc_min.z; }
@@ -1488,62 +3319,670 @@ auto uka::gltf::Model::get_scene_dimensions() -> void
 
 auto uka::gltf::Model::updateAnimation(uint32_t index, float time) -> void
 {
-    if(index > animations.size()-1)
+    if(index >= animation_clips.size())
     {
         return;
     }
-    auto& animation = animations[index];
-    auto updated = false;
-    for(auto& channel:animation.channels)
+    const auto& clip = animation_clips[index];
+    uka::animation::sample(clip, time, animation_cursors[index], animated_pose);
+    // Only the animated properties are written, everything else keeps what the application set
+    for(auto target : clip.translation.targets)
     {
-        auto sampler = animation.samplers[channel.sampler_index];
-        if(sampler.inputs.size() > sampler.outputs.size())
+        linear_nodes[target]->translation = glm::vec3(animated_pose.translation[0][target], animated_pose.translation[1][target], animated_pose.translation[2][target]);
+    }
+    for(auto target : clip.rotation.targets)
+    {
+        linear_nodes[target]->rotation = glm::quat(animated_pose.rotation[3][target], animated_pose.rotation[0][target], animated_pose.rotation[1][target], animated_pose.rotation[2][target]);
+    }
+    for(auto target : clip.scale.targets)
+    {
+        linear_nodes[target]->scale = glm::vec3(animated_pose.scale[0][target], animated_pose.scale[1][target], animated_pose.scale[2][target]);
+    }
+    for(const auto* stream : {&clip.translation, &clip.rotation, &clip.scale})
+    {
+        for(auto target : stream->targets)
+        {
+            linear_nodes[target]->mark_dirty();
+        }
+    }
+    update_transforms();
+}
+
+auto uka::gltf::Model::blend_animations(const uka::animation::Layer* layers, size_t layer_count) -> void
+{
+    uka::animation::blend(rest_pose, layers, layer_count, animated_pose);
+    apply_pose(animated_pose);
+}
+
+auto uka::gltf::Model::apply_pose(const uka::animation::Pose& pose) -> void
+{
+    for(auto i = size_t{0}; i < linear_nodes.size(); i++)
+    {
+        auto* node = linear_nodes[i];
+        node->translation = glm::vec3(pose.translation[0][i], pose.translation[1][i], pose.translation[2][i]);
+        node->rotation = glm::quat(pose.rotation[3][i], pose.rotation[0][i], pose.rotation[1][i], pose.rotation[2][i]);
+        node->scale = glm::vec3(pose.scale[0][i], pose.scale[1][i], pose.scale[2][i]);
+        node->mark_dirty();
+    }
+    update_transforms();
+}
+
+// Recomputes world matrices below node. Clean subtrees under an unchanged parent are skipped entirely.
+static auto propagate_transforms(uka::gltf::Node* node, const glm::mat4& parent_world, bool parent_changed, uint64_t generation) -> void
+{
+    auto changed = parent_changed || node->dirty;
+    if(changed)
+    {
+        node->world_matrix = parent_world * node->local_matrix_from_node();
+        node->world_generation = generation;
+        node->dirty = false;
+    }
+    if(changed || node->subtree_dirty)
+    {
+        for(auto child : node->children)
+        {
+            propagate_transforms(child, node->world_matrix, changed, generation);
+        }
+    }
+    node->subtree_dirty = false;
+}
+
+auto uka::gltf::Model::update_transforms() -> void
+{
+    struct Subtree
+    {
+        Node* node;
+        bool parent_changed;
+    };
+    auto subtrees = std::vector<Subtree>();
+    for(auto node : nodes)
+    {
+        if(node->dirty || node->subtree_dirty)
+        {
+            subtrees.push_back({node, false});
+        }
+    }
+    if(subtrees.empty())
+    {
+        return;
+    }
+    const auto generation = ++transform_generation;
+    auto parent_world = [](const Node* node) { return node->parent ? node->parent->world_matrix : glm::mat4(1.0f); };
+
+    // Most assets hang everything below one root, walk down until the hierarchy branches into independent subtrees
+    while(subtrees.size() == 1 && !subtrees[0].node->children.empty())
+    {
+        auto subtree = subtrees[0];
+        auto* node = subtree.node;
+        auto changed = subtree.parent_changed || node->dirty;
+        if(changed)
+        {
+            node->world_matrix = parent_world(node) * node->local_matrix_from_node();
+            node->world_generation = generation;
+            node->dirty = false;
+        }
+        node->subtree_dirty = false;
+        subtrees.clear();
+        for(auto child : node->children)
+        {
+            if(changed || child->dirty || child->subtree_dirty)
+            {
+                subtrees.push_back({child, changed});
+            }
+        }
+    }
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(subtrees.size()), [&](uint32_t i)
+    {
+        propagate_transforms(subtrees[i].node, parent_world(subtrees[i].node), subtrees[i].parent_changed, generation);
+    });
+
+    // Meshes follow their node, skinned meshes also follow every joint
+    auto skin_changed = std::vector<char>(skins.size(), 0);
+    for(auto s = size_t{0}; s < skins.size(); s++)
+    {
+        skin_changed[s] = std::any_of(skins[s]->joints.begin(), skins[s]->joints.end(), [&](const Node* joint) { return joint->world_generation == generation; });
+    }
+    auto changed_meshes = std::vector<Node*>();
+    for(auto node : linear_nodes)
+    {
+        if(node->mesh && (node->world_generation == generation || (node->skin && skin_changed[node->skin_index])))
+        {
+            changed_meshes.push_back(node);
+        }
+    }
+    uka::Uka_Thread_Pool::global().parallel_for(static_cast<uint32_t>(changed_meshes.size()), [&](uint32_t i)
+    {
+        auto* node = changed_meshes[i];
+        node->update_mesh_transform(mesh_transforms[node->transform_index], joint_matrices.data() + node->first_joint);
+    });
+
+    // Model space boxes of moved primitives, the transformed box of the local box is
+    // center = M * c, extent = |M| * e
+    for(auto i = size_t{0}; i < primitive_instances.size(); i++)
+    {
+        const auto* node = primitive_instances[i].node;
+        if(node->world_generation != generation)
         {
             continue;
         }
-        for(auto i=0;i<sampler.inputs.size();i++)
+        auto box_min = glm::vec3(std::numeric_limits<float>::lowest());
+        auto box_max = glm::vec3(std::numeric_limits<float>::max());
+        if(!node->skin)
         {
-            if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-                float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-                if (u <= 1.0f) {
-                    switch (channel.path) {
-                    case AnimationChannel::PathType::TRANSLATION: {
-                        glm::vec4 trans = glm::mix(sampler.outputs[i], sampler.outputs[i + 1], u);
-                        channel.target_node->translation = glm::vec3(trans);
-                        break;
-                    }
-                    case AnimationChannel::PathType::SCALE: {
-                        glm::vec4 trans = glm::mix(sampler.outputs[i], sampler.outputs[i + 1], u);
-                        channel.target_node->scale = glm::vec3(trans);
-                        break;
-                    }
-                    case AnimationChannel::PathType::ROTATION: {
-                        glm::quat q1;
-                        q1.x = sampler.outputs[i].x;
-                        q1.y = sampler.outputs[i].y;
-                        q1.z = sampler.outputs[i].z;
-                        q1.w = sampler.outputs[i].w;
-                        glm::quat q2;
-                        q2.x = sampler.outputs[i + 1].x;
-                        q2.y = sampler.outputs[i + 1].y;
-                        q2.z = sampler.outputs[i + 1].z;
-                        q2.w = sampler.outputs[i + 1].w;
-                        channel.target_node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-                        break;
-                        }
-                    }
-                    updated = true;
-                }
+            const auto& world_matrix = node->world_matrix;
+            const auto& dimensions = primitive_instances[i].primitive->dimensions;
+            auto center = glm::vec3(world_matrix * glm::vec4((dimensions.min + dimensions.max) * 0.5f, 1.0f));
+            auto extent = (dimensions.max - dimensions.min) * 0.5f;
+            auto world_extent = glm::abs(glm::vec3(world_matrix[0])) * extent.x + glm::abs(glm::vec3(world_matrix[1])) * extent.y + glm::abs(glm::vec3(world_matrix[2])) * extent.z;
+            box_min = center - world_extent;
+            box_max = center + world_extent;
+        }
+        primitive_bounds.set(i, glm::value_ptr(box_min), glm::value_ptr(box_max));
+    }
+}
+
+auto uka::gltf::Model::upload_transforms(uint32_t frame_index) -> void
+{
+    if(transforms.uploaded_generation[frame_index] == transform_generation)
+    {
+        return;
+    }
+    auto* frame = transforms.mapped + transforms.frame_size * frame_index;
+    memcpy(frame, mesh_transforms.data(), mesh_transforms.size() * sizeof(MeshTransform));
+    memcpy(frame + transforms.joints_offset, joint_matrices.data(), joint_matrices.size() * sizeof(glm::mat4));
+    transforms.uploaded_generation[frame_index] = transform_generation;
+}
+
+auto uka::gltf::Model::bind_transforms(VkCommandBuffer commandbuffer,
+    VkPipelineLayout pipeline_layout,
+    uint32_t set,
+    uint32_t frame_index,
+    VkPipelineBindPoint bind_point) -> void
+{
+    const auto offset = static_cast<uint32_t>(transforms.frame_size * frame_index);
+    const uint32_t dynamic_offsets[2] = {offset, offset};
+    vkCmdBindDescriptorSets(commandbuffer, bind_point, pipeline_layout, set, 1, &transforms.descriptor_set, 2, dynamic_offsets);
+}
+
+auto uka::gltf::Model::prepare_skinning(const std::string& shader_file, VkPipelineCache pipeline_cache) -> void
+{
+    if(skinning.vertex_count == 0 || skinning.pipeline != VK_NULL_HANDLE)
+    {
+        return;
+    }
+    // 0: source vertices, 1: joint matrices, 2: skinned vertices
+    std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+    };
+    auto set_layout_create_info = uka::init::descriptor_set_layout_create_info(set_layout_bindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &set_layout_create_info, nullptr, &skinning.descriptor_set_layout));
+
+    std::vector<VkDescriptorPoolSize> pool_sizes = {
+        uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frames_in_flight),
+    };
+    auto pool_create_info = uka::init::descriptor_pool_create_info(pool_sizes, frames_in_flight);
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device->logical_device, &pool_create_info, nullptr, &skinning.descriptor_pool));
+
+    auto set_layouts = std::vector<VkDescriptorSetLayout>(frames_in_flight, skinning.descriptor_set_layout);
+    auto allocate_info = uka::init::descriptor_set_allocate_info(skinning.descriptor_pool, frames_in_flight, set_layouts.data());
+    skinning.descriptor_sets.resize(frames_in_flight);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &allocate_info, skinning.descriptor_sets.data()));
+    for(auto frame = uint32_t{0}; frame < frames_in_flight; frame++)
+    {
+        auto source_info = VkDescriptorBufferInfo{vertices.buffer, 0, VK_WHOLE_SIZE};
+        auto joints_info = VkDescriptorBufferInfo{transforms.buffer, transforms.frame_size * frame + transforms.joints_offset, joint_matrices.size() * sizeof(glm::mat4)};
+        auto output_info = VkDescriptorBufferInfo{skinning.output, 0, VK_WHOLE_SIZE};
+        std::vector<VkWriteDescriptorSet> writes = {
+            uka::init::write_descriptor_set(skinning.descriptor_sets[frame], 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &source_info),
+            uka::init::write_descriptor_set(skinning.descriptor_sets[frame], 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &joints_info),
+            uka::init::write_descriptor_set(skinning.descriptor_sets[frame], 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &output_info),
+        };
+        vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    auto push_constant_range = uka::init::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinningDispatch));
+    auto pipeline_layout_create_info = uka::init::pipeline_layout_create_info(1, &skinning.descriptor_set_layout);
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device->logical_device, &pipeline_layout_create_info, nullptr, &skinning.pipeline_layout));
+
+    auto shader_stage = VkPipelineShaderStageCreateInfo{};
+    shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shader_stage.module = uka::tools::load_shader(shader_file, device->logical_device);
+    shader_stage.pName = "main";
+    assert(shader_stage.module != VK_NULL_HANDLE);
+    auto pipeline_create_info = uka::init::compute_pipeline_create_info(skinning.pipeline_layout);
+    pipeline_create_info.stage = shader_stage;
+    VK_CHECK_RESULT(vkCreateComputePipelines(device->logical_device, pipeline_cache, 1, &pipeline_create_info, nullptr, &skinning.pipeline));
+    vkDestroyShaderModule(device->logical_device, shader_stage.module, nullptr);
+}
+
+auto uka::gltf::Model::record_skinning(VkCommandBuffer commandbuffer, uint32_t frame_index) -> void
+{
+    if(skinning.pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    // The previous frame's passes may still read the output, wait for its vertex fetches before overwriting it
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+    vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline);
+    vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline_layout, 0, 1, &skinning.descriptor_sets[frame_index], 0, nullptr);
+    for(auto node : linear_nodes)
+    {
+        if(!node->mesh || !node->skin)
+        {
+            continue;
+        }
+        for(auto primitive : node->mesh->primitives)
+        {
+            auto dispatch = SkinningDispatch{};
+            dispatch.first_vertex = primitive->first_vertex;
+            dispatch.vertex_count = primitive->vertex_count;
+            dispatch.first_joint = node->first_joint;
+            dispatch.output_first_vertex = static_cast<uint32_t>(static_cast<int32_t>(primitive->first_vertex) + primitive->skinned_vertex_offset);
+            vkCmdPushConstants(commandbuffer, skinning.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(dispatch), &dispatch);
+            vkCmdDispatch(commandbuffer, (primitive->vertex_count + 63) / 64, 1, 1);
+        }
+    }
+    auto barrier = uka::init::buffer_memory_barrier();
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = skinning.output;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+auto uka::gltf::Model::prepare_indirect(VkQueue transfer_queue) -> void
+{
+    if(!device->enabled_features.drawIndirectFirstInstance)
+    {
+        throw std::runtime_error("Indirect drawing needs the drawIndirectFirstInstance feature");
+    }
+    if(indirect.buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device->logical_device, indirect.buffer, nullptr);
+        vkFreeMemory(device->logical_device, indirect.memory, nullptr);
+        indirect = Indirect{};
+    }
+    std::vector<VkDrawIndexedIndirectCommand> group_commands[Indirect::group_count];
+    std::vector<DrawData> group_draw_data[Indirect::group_count];
+    std::vector<PrimitiveInstance> group_instances[Indirect::group_count];
+    for(auto node : linear_nodes)
+    {
+        if(!node->mesh)
+        {
+            continue;
+        }
+        const auto skinned = node->skin && skinning.pipeline != VK_NULL_HANDLE;
+        for(auto primitive : node->mesh->primitives)
+        {
+            const auto alpha_mode = static_cast<uint32_t>(materials[primitive->material_index].alpha_mode);
+            assert(alpha_mode <= Material::APLHA_BLEND);
+            const auto group = alpha_mode * 2 + (skinned ? 1 : 0);
+            auto command = VkDrawIndexedIndirectCommand{};
+            command.indexCount = primitive->index_count;
+            command.instanceCount = 1;
+            command.firstIndex = primitive->first_index;
+            command.vertexOffset = primitive->vertex_offset + (skinned ? primitive->skinned_vertex_offset : 0);
+            group_commands[group].push_back(command);
+            auto draw_data = DrawData{};
+            draw_data.dequantization_offset = primitive->dequantization.offset;
+            draw_data.dequantization_scale = primitive->dequantization.scale;
+            draw_data.transform_index = node->transform_index;
+            draw_data.material_index = primitive->material_index;
+            group_draw_data[group].push_back(draw_data);
+            group_instances[group].push_back({node, primitive});
+        }
+    }
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    std::vector<DrawData> draw_data;
+    uint32_t draw_counts[Indirect::group_count];
+    for(auto group = uint32_t{0}; group < Indirect::group_count; group++)
+    {
+        indirect.first_command[group] = static_cast<uint32_t>(commands.size());
+        indirect.command_count[group] = static_cast<uint32_t>(group_commands[group].size());
+        draw_counts[group] = indirect.command_count[group];
+        for(auto& command : group_commands[group])
+        {
+            command.firstInstance = static_cast<uint32_t>(commands.size());
+            commands.push_back(command);
+        }
+        draw_data.insert(draw_data.end(), group_draw_data[group].begin(), group_draw_data[group].end());
+        indirect.instances.insert(indirect.instances.end(), group_instances[group].begin(), group_instances[group].end());
+    }
+    indirect.draw_count = static_cast<uint32_t>(commands.size());
+    if(indirect.draw_count == 0)
+    {
+        return;
+    }
+
+    const auto alignment = std::max<VkDeviceSize>(device->properties.limits.minStorageBufferOffsetAlignment, 16);
+    auto align = [&](VkDeviceSize size) { return (size + alignment - 1) / alignment * alignment; };
+    indirect.commands_offset = align(sizeof(draw_counts));
+    indirect.draw_data_offset = align(indirect.commands_offset + commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    const auto draw_data_size = draw_data.size() * sizeof(DrawData);
+    const auto buffer_size = indirect.draw_data_offset + draw_data_size;
+    std::vector<unsigned char> upload(buffer_size, 0);
+    memcpy(upload.data(), draw_counts, sizeof(draw_counts));
+    memcpy(upload.data() + indirect.commands_offset, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    memcpy(upload.data() + indirect.draw_data_offset, draw_data.data(), draw_data_size);
+
+    auto staging_buffer = VkBuffer{};
+    auto staging_memory = VkDeviceMemory{};
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer_size, &staging_buffer, &staging_memory, upload.data()));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer_size, &indirect.buffer, &indirect.memory));
+    auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    auto copy_region = VkBufferCopy{};
+    copy_region.size = buffer_size;
+    vkCmdCopyBuffer(copy_cmd, staging_buffer, indirect.buffer, 1, &copy_region);
+    device->flush_command_buffer(copy_cmd, transfer_queue);
+    vkDestroyBuffer(device->logical_device, staging_buffer, nullptr);
+    vkFreeMemory(device->logical_device, staging_memory, nullptr);
+
+    auto draw_data_info = VkDescriptorBufferInfo{indirect.buffer, indirect.draw_data_offset, draw_data_size};
+    auto write = uka::init::write_descriptor_set(transforms.descriptor_set, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &draw_data_info);
+    vkUpdateDescriptorSets(device->logical_device, 1, &write, 0, nullptr);
+
+    if(draw_indirect_count)
+    {
+        indirect.draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->logical_device, "vkCmdDrawIndexedIndirectCount"));
+        if(!indirect.draw_indexed_indirect_count)
+        {
+            indirect.draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->logical_device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+    }
+}
+
+auto uka::gltf::Model::draw_indirect(VkCommandBuffer commandbuffer, uint32_t render_flags, uint32_t vertex_streams) -> void
+{
+    if(indirect.buffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    draw_indirect_groups(commandbuffer, indirect.buffer, indirect.commands_offset, 0, render_flags, vertex_streams);
+}
+
+auto uka::gltf::Model::draw_indirect_groups(VkCommandBuffer commandbuffer,
+    VkBuffer buffer,
+    VkDeviceSize commands_offset,
+    VkDeviceSize counts_offset,
+    uint32_t render_flags,
+    uint32_t vertex_streams) -> void
+{
+    if(!buffers_bound)
+    {
+        bind_buffers(commandbuffer, vertex_streams);
+        buffers_bound = false;
+    }
+    const auto alpha_filter = render_flags & (RENDER_OPAQUE_NODES | RENDER_ALPHA_MASKED_NODES | RENDER_ALPHA_BLENDED_NODES);
+    const uint32_t alpha_flags[3] = { RENDER_OPAQUE_NODES, RENDER_ALPHA_MASKED_NODES, RENDER_ALPHA_BLENDED_NODES };
+    const auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+    const VkDeviceSize offsets[1] = { 0 };
+    for(auto group = uint32_t{0}; group < Indirect::group_count; group++)
+    {
+        const auto count = indirect.command_count[group];
+        if(count == 0 || (alpha_filter && !(alpha_filter & alpha_flags[group / 2])))
+        {
+            continue;
+        }
+        const auto skinned = (group & 1) != 0;
+        if(skinned)
+        {
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, &skinning.output, offsets);
+        }
+        const auto offset = commands_offset + VkDeviceSize{indirect.first_command[group]} * stride;
+        if(indirect.draw_indexed_indirect_count)
+        {
+            indirect.draw_indexed_indirect_count(commandbuffer, buffer, offset, buffer, counts_offset + group * sizeof(uint32_t), count, stride);
+        }
+        else if(device->enabled_features.multiDrawIndirect)
+        {
+            vkCmdDrawIndexedIndirect(commandbuffer, buffer, offset, count, stride);
+        }
+        else
+        {
+            for(auto draw = uint32_t{0}; draw < count; draw++)
+            {
+                vkCmdDrawIndexedIndirect(commandbuffer, buffer, offset + VkDeviceSize{draw} * stride, 1, stride);
             }
         }
+        if(skinned)
+        {
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, &vertices.buffer, offsets);
+        }
+    }
+}
+
+auto uka::gltf::Model::prepare_gpu_culling(const std::string& shader_file, VkQueue transfer_queue, uint32_t view_count, VkPipelineCache pipeline_cache) -> void
+{
+    if(indirect.draw_count == 0 || view_count == 0 || gpu_culling.pipeline != VK_NULL_HANDLE)
+    {
+        return;
     }
-    if(updated)
+    gpu_culling.view_count = view_count;
+
+    // Local boxes in command order, transformed on the GPU with the frame's mesh transforms
+    std::vector<CullRecord> records(indirect.draw_count);
+    for(auto draw = uint32_t{0}; draw < indirect.draw_count; draw++)
     {
-        for(auto& node : nodes)
+        const auto* node = indirect.instances[draw].node;
+        const auto& dimensions = indirect.instances[draw].primitive->dimensions;
+        auto& record = records[draw];
+        record.center = (dimensions.min + dimensions.max) * 0.5f;
+        record.extent = (dimensions.max - dimensions.min) * 0.5f;
+        record.transform_index = node->transform_index;
+        record.always_visible = node->skin && skinning.pipeline != VK_NULL_HANDLE ? 1 : 0;
+        for(auto group = uint32_t{0}; group < Indirect::group_count; group++)
         {
-            node->update();
+            if(draw >= indirect.first_command[group] && draw < indirect.first_command[group] + indirect.command_count[group])
+            {
+                record.group = group;
+                record.group_first_command = indirect.first_command[group];
+            }
         }
     }
+    const auto records_size = records.size() * sizeof(CullRecord);
+    auto staging_buffer = VkBuffer{};
+    auto staging_memory = VkDeviceMemory{};
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, records_size, &staging_buffer, &staging_memory, records.data()));
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, records_size, &gpu_culling.records, &gpu_culling.records_memory));
+    auto copy_cmd = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    auto copy_region = VkBufferCopy{};
+    copy_region.size = records_size;
+    vkCmdCopyBuffer(copy_cmd, staging_buffer, gpu_culling.records, 1, &copy_region);
+    device->flush_command_buffer(copy_cmd, transfer_queue);
+    vkDestroyBuffer(device->logical_device, staging_buffer, nullptr);
+    vkFreeMemory(device->logical_device, staging_memory, nullptr);
+
+    // One region of draw counts and commands per frame in flight and view
+    const auto alignment = std::max<VkDeviceSize>(device->properties.limits.minStorageBufferOffsetAlignment, 16);
+    auto align = [&](VkDeviceSize size) { return (size + alignment - 1) / alignment * alignment; };
+    const auto counts_size = VkDeviceSize{Indirect::group_count * sizeof(uint32_t)};
+    const auto commands_size = VkDeviceSize{indirect.draw_count} * sizeof(VkDrawIndexedIndirectCommand);
+    gpu_culling.commands_offset = align(counts_size);
+    gpu_culling.region_size = align(gpu_culling.commands_offset + commands_size);
+    const auto region_count = frames_in_flight * view_count;
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpu_culling.region_size * region_count, &gpu_culling.output, &gpu_culling.output_memory));
+
+    // 0: cull records, 1: source commands, 2: mesh transforms, 3: draw counts, 4: surviving commands
+    std::vector<VkDescriptorSetLayoutBinding> set_layout_bindings = {
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+    };
+    auto set_layout_create_info = uka::init::descriptor_set_layout_create_info(set_layout_bindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &set_layout_create_info, nullptr, &gpu_culling.descriptor_set_layout));
+
+    // 0: Hi-Z pyramid, 1: occlusion parameters
+    std::vector<VkDescriptorSetLayoutBinding> occlusion_bindings = {
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        uka::init::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+    };
+    auto occlusion_layout_create_info = uka::init::descriptor_set_layout_create_info(occlusion_bindings);
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logical_device, &occlusion_layout_create_info, nullptr, &gpu_culling.occlusion_set_layout));
+
+    std::vector<VkDescriptorPoolSize> pool_sizes = {
+        uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * region_count),
+        uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, frames_in_flight),
+        uka::init::descriptor_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames_in_flight),
+    };
+    auto pool_create_info = uka::init::descriptor_pool_create_info(pool_sizes, region_count + frames_in_flight);
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device->logical_device, &pool_create_info, nullptr, &gpu_culling.descriptor_pool));
+
+    auto set_layouts = std::vector<VkDescriptorSetLayout>(region_count, gpu_culling.descriptor_set_layout);
+    auto allocate_info = uka::init::descriptor_set_allocate_info(gpu_culling.descriptor_pool, region_count, set_layouts.data());
+    gpu_culling.descriptor_sets.resize(region_count);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &allocate_info, gpu_culling.descriptor_sets.data()));
+    for(auto frame = uint32_t{0}; frame < frames_in_flight; frame++)
+    {
+        for(auto view = uint32_t{0}; view < view_count; view++)
+        {
+            const auto region = frame * view_count + view;
+            const auto set = gpu_culling.descriptor_sets[region];
+            auto records_info = VkDescriptorBufferInfo{gpu_culling.records, 0, records_size};
+            auto source_info = VkDescriptorBufferInfo{indirect.buffer, indirect.commands_offset, commands_size};
+            auto transforms_info = VkDescriptorBufferInfo{transforms.buffer, transforms.frame_size * frame, mesh_transforms.size() * sizeof(MeshTransform)};
+            auto counts_info = VkDescriptorBufferInfo{gpu_culling.output, gpu_culling.region_size * region, counts_size};
+            auto commands_info = VkDescriptorBufferInfo{gpu_culling.output, gpu_culling.region_size * region + gpu_culling.commands_offset, commands_size};
+            std::vector<VkWriteDescriptorSet> writes = {
+                uka::init::write_descriptor_set(set, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &records_info),
+                uka::init::write_descriptor_set(set, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &source_info),
+                uka::init::write_descriptor_set(set, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &transforms_info),
+                uka::init::write_descriptor_set(set, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &counts_info),
+                uka::init::write_descriptor_set(set, 4, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &commands_info),
+            };
+            vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    }
+
+    // The pyramid is only known once a Uka_Hiz is passed to record_gpu_culling, its sets are written there
+    const auto uniform_alignment = std::max<VkDeviceSize>(device->properties.limits.minUniformBufferOffsetAlignment, 16);
+    gpu_culling.occlusion_stride = (sizeof(OcclusionParams) + uniform_alignment - 1) / uniform_alignment * uniform_alignment;
+    VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, gpu_culling.occlusion_stride * frames_in_flight, &gpu_culling.occlusion_buffer, &gpu_culling.occlusion_memory));
+    VK_CHECK_RESULT(vkMapMemory(device->logical_device, gpu_culling.occlusion_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&gpu_culling.occlusion_mapped)));
+    auto occlusion_layouts = std::vector<VkDescriptorSetLayout>(frames_in_flight, gpu_culling.occlusion_set_layout);
+    auto occlusion_allocate_info = uka::init::descriptor_set_allocate_info(gpu_culling.descriptor_pool, frames_in_flight, occlusion_layouts.data());
+    gpu_culling.occlusion_sets.resize(frames_in_flight);
+    gpu_culling.occlusion_views.assign(frames_in_flight, VK_NULL_HANDLE);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &occlusion_allocate_info, gpu_culling.occlusion_sets.data()));
+
+    const VkDescriptorSetLayout set_layouts_culling[2] = { gpu_culling.descriptor_set_layout, gpu_culling.occlusion_set_layout };
+    auto pipeline_layout_create_info = uka::init::pipeline_layout_create_info(2, set_layouts_culling);
+    auto push_constant_range = uka::init::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingView));
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device->logical_device, &pipeline_layout_create_info, nullptr, &gpu_culling.pipeline_layout));
+
+    auto shader_stage = VkPipelineShaderStageCreateInfo{};
+    shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shader_stage.module = uka::tools::load_shader(shader_file, device->logical_device);
+    shader_stage.pName = "main";
+    assert(shader_stage.module != VK_NULL_HANDLE);
+    auto pipeline_create_info = uka::init::compute_pipeline_create_info(gpu_culling.pipeline_layout);
+    pipeline_create_info.stage = shader_stage;
+    VK_CHECK_RESULT(vkCreateComputePipelines(device->logical_device, pipeline_cache, 1, &pipeline_create_info, nullptr, &gpu_culling.pipeline));
+    pipeline_create_info.stage.pName = "mainOcclusion";
+    VK_CHECK_RESULT(vkCreateComputePipelines(device->logical_device, pipeline_cache, 1, &pipeline_create_info, nullptr, &gpu_culling.occlusion_pipeline));
+    vkDestroyShaderModule(device->logical_device, shader_stage.module, nullptr);
+}
+
+auto uka::gltf::Model::record_gpu_culling(VkCommandBuffer commandbuffer,
+    uint32_t frame_index,
+    const uka::Uka_Frustum* frusta,
+    uint32_t frustum_count,
+    const uka::Uka_Hiz* hiz,
+    const glm::mat4& model_matrix) -> void
+{
+    if(gpu_culling.pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    frustum_count = std::min(frustum_count, gpu_culling.view_count);
+    const auto first_region = frame_index * gpu_culling.view_count;
+    // The pyramid holds the previous frame's depth, boxes are projected with the matrices it was rendered with.
+    // The frame's sets are no longer in use here, so rewriting them after a resize is safe.
+    const auto occlusion = hiz && hiz->ready;
+    if(occlusion)
+    {
+        auto params = OcclusionParams{};
+        params.view_projection = hiz->view_projection * model_matrix;
+        params.size = glm::vec2(static_cast<float>(hiz->width), static_cast<float>(hiz->height));
+        params.mip_levels = hiz->mip_levels;
+        memcpy(gpu_culling.occlusion_mapped + gpu_culling.occlusion_stride * frame_index, &params, sizeof(params));
+        if(gpu_culling.occlusion_views[frame_index] != hiz->view)
+        {
+            auto pyramid_info = uka::init::descriptor_img_info(VK_NULL_HANDLE, hiz->view, VK_IMAGE_LAYOUT_GENERAL);
+            auto params_info = VkDescriptorBufferInfo{gpu_culling.occlusion_buffer, gpu_culling.occlusion_stride * frame_index, sizeof(OcclusionParams)};
+            std::vector<VkWriteDescriptorSet> writes = {
+                uka::init::write_descriptor_set(gpu_culling.occlusion_sets[frame_index], 0, 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &pyramid_info),
+                uka::init::write_descriptor_set(gpu_culling.occlusion_sets[frame_index], 1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &params_info),
+            };
+            vkUpdateDescriptorSets(device->logical_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+            gpu_culling.occlusion_views[frame_index] = hiz->view;
+        }
+    }
+    // Counts restart at zero, the commands of the frame's regions were consumed by this frame's previous use
+    for(auto view = uint32_t{0}; view < frustum_count; view++)
+    {
+        vkCmdFillBuffer(commandbuffer, gpu_culling.output, gpu_culling.region_size * (first_region + view), Indirect::group_count * sizeof(uint32_t), 0);
+    }
+    auto barrier = uka::init::buffer_memory_barrier();
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = gpu_culling.output;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    for(auto view = uint32_t{0}; view < frustum_count; view++)
+    {
+        // Only the camera view has a depth pyramid
+        if(view == 0 || (view == 1 && occlusion))
+        {
+            const auto test_occlusion = view == 0 && occlusion;
+            vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, test_occlusion ? gpu_culling.occlusion_pipeline : gpu_culling.pipeline);
+            if(test_occlusion)
+            {
+                vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu_culling.pipeline_layout, 1, 1, &gpu_culling.occlusion_sets[frame_index], 0, nullptr);
+            }
+        }
+        vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu_culling.pipeline_layout, 0, 1, &gpu_culling.descriptor_sets[first_region + view], 0, nullptr);
+        auto culling_view = CullingView{};
+        for(auto p = 0; p < 6; p++)
+        {
+            culling_view.planes[p] = frusta[view].planes[p];
+        }
+        culling_view.draw_count = indirect.draw_count;
+        // Without an indirect count the commands keep their slots and culled ones draw zero instances
+        culling_view.compact = indirect.draw_indexed_indirect_count ? 1 : 0;
+        vkCmdPushConstants(commandbuffer, gpu_culling.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(culling_view), &culling_view);
+        vkCmdDispatch(commandbuffer, (indirect.draw_count + 63) / 64, 1, 1);
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+auto uka::gltf::Model::draw_gpu_culled(VkCommandBuffer commandbuffer, uint32_t frame_index, uint32_t view, uint32_t render_flags, uint32_t vertex_streams) -> void
+{
+    if(gpu_culling.pipeline == VK_NULL_HANDLE || view >= gpu_culling.view_count)
+    {
+        return;
+    }
+    const auto region_offset = gpu_culling.region_size * (frame_index * gpu_culling.view_count + view);
+    draw_indirect_groups(commandbuffer, gpu_culling.output, region_offset + gpu_culling.commands_offset, region_offset, render_flags, vertex_streams);
 }
 
 auto uka::gltf::Model::find_node(uka::gltf::Node* parent, uint32_t index) -> uka::gltf::Node*
@@ -1563,38 +4002,6 @@ auto uka::gltf::Model::find_node(uka::gltf::Node* parent, uint32_t index) -> uka
 
 auto uka::gltf::Model::node_from_index(uint32_t index) -> uka::gltf::Node*
 {
-    Node* node_found = nullptr;
-    for (auto &node : nodes) {
-        node_found = find_node(node, index);
-        if (node_found) {
-            break;
-        }
-    }
-    return node_found;
+    return index < node_lookup.size() ? node_lookup[index] : nullptr;
 }
 
-auto uka::gltf::Model::prepare_node_descriptor_set(uka::gltf::Node* node,
-    VkDescriptorSetLayout descriptor_set_layout) -> void
-{
-    if (node->mesh) {
-        auto desc_set_alloc_info = VkDescriptorSetAllocateInfo{};
-        desc_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        desc_set_alloc_info.descriptorPool = descriptor_pool;
-        desc_set_alloc_info.pSetLayouts = &descriptor_set_layout;
-        desc_set_alloc_info.descriptorSetCount = 1;
-        VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logical_device, &desc_set_alloc_info, &node->mesh->uniform_buffer.descriptor_set));
-
-        VkWriteDescriptorSet writeDescriptorSet{};
-        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writeDescriptorSet.descriptorCount = 1;
-        writeDescriptorSet.dstSet = node->mesh->uniform_buffer.descriptor_set;
-        writeDescriptorSet.dstBinding = 0;
-        writeDescriptorSet.pBufferInfo = &node->mesh->uniform_buffer.descriptor;
-
-        vkUpdateDescriptorSets(device->logical_device, 1, &writeDescriptorSet, 0, nullptr);
-    }
-    for (auto& child : node->children) {
-        prepare_node_descriptor_set(child, descriptor_set_layout);
-    }
-}
@@ -1,12 +1,23 @@
 #pragma once
 
 #include <cstdlib>
+#include <limits>
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <utility>
 
 #include "vulkan/vulkan.h"
 #include "uka-device.hpp"
+#include "uka-mapped-file.hpp"
+#include "uka-mesh-optimizer.hpp"
+#include "uka-animation.hpp"
+#include "uka-arena.hpp"
+#include "uka-frustum.hpp"
+#include "uka-culling.hpp"
+#include "uka-hiz.hpp"
+#include "uka-upload-batch.hpp"
 
 #include "ktx.h"
 #include "ktxvulkan.h"
@@ -30,10 +41,56 @@ namespace uka
             image_normal_map =0x00000002,
         };
 
+        // Compact vertex encodings, selected before loading and before building pipelines
+        enum VertexCompression
+        {
+            COMPRESS_NONE = 0x00000000,
+            // R16G16B16A16_UNORM relative to the primitive bounds, see Primitive::dequantization
+            COMPRESS_POSITION_UNORM16 = 0x00000001,
+            // Octahedral R16G16_SNORM normals and R8G8B8A8_SNORM tangents (xy octahedral, w sign)
+            COMPRESS_NORMAL_OCTAHEDRAL = 0x00000002,
+            COMPRESS_UV_HALF = 0x00000004,
+            // R8G8B8A8_UNORM colors and weights
+            COMPRESS_COLOR_UNORM8 = 0x00000008,
+            // Fails the load when a skin has more than 256 joints
+            COMPRESS_JOINTS_UINT8 = 0x00000010,
+            COMPRESS_JOINTS_UINT16 = 0x00000020,
+        };
+
         extern VkDescriptorSetLayout descriptor_set_layout_image;
-        extern VkDescriptorSetLayout descriptor_set_layout_ubo;
+        // Set of Model::bindless for BINDLESS_MATERIALS: binding 0 MaterialData[], binding 1 a variable sized
+        // combined image sampler array of up to max_bindless_textures
+        extern VkDescriptorSetLayout descriptor_set_layout_bindless;
+        extern uint32_t max_bindless_textures;
+        // STREAM_TEXTURES loads the levels up to this size with the model and streams the larger ones
+        extern uint32_t streaming_tail_size;
+        // Staging bytes one Model::update_texture_streaming call submits, at least one level goes out regardless
+        extern VkDeviceSize streaming_batch_size;
+        // Set of Model::transforms: binding 0 MeshTransform[], binding 1 joint matrices, both dynamic storage buffers,
+        // binding 2 DrawData[] once prepare_indirect ran
+        extern VkDescriptorSetLayout descriptor_set_layout_transforms;
+        // Copies of the transforms buffer, one per frame in flight
+        extern uint32_t frames_in_flight;
         extern VkMemoryPropertyFlags memory_property_flags;
         extern uint32_t descriptor_binding_flags;
+        extern uint32_t vertex_compression;
+        // Directory for decoded geometry caches, empty keeps them next to the asset
+        extern std::string model_cache_directory;
+        // Set when the device was created with drawIndirectCount (Vulkan 1.2) or VK_KHR_draw_indirect_count,
+        // Model::draw_indirect then reads the draw counts from the indirect buffer
+        extern bool draw_indirect_count;
+
+        // Per-attribute tolerances for WELD_VERTICES, 0 only merges bit-identical values. Joints always match exactly.
+        struct WeldTolerances
+        {
+            float position = 0.0f;
+            float normal = 1e-3f;
+            float uv = 1e-5f;
+            float color = 1.0f / 512.0f;
+            float tangent = 1e-3f;
+            float weights = 1.0f / 512.0f;
+        };
+        extern WeldTolerances weld_tolerances;
 
         struct Node;
 
@@ -50,10 +107,32 @@ namespace uka
             VkDescriptorImageInfo descriptor;
             VkSampler sampler;
             uint32_t index;
+            VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+            // Most detailed level in image_view, the levels above it are still streaming
+            uint32_t resident_level = 0;
 
             auto update_descriptor() -> void;
             auto destroy() -> void;
             auto from_gltf_image(const tinygltf::Image& gltf_image,std::string path, uka::Uka_Device* device, VkQueue copy_queue) -> void;
+            // A KTX or KTX2 image opened ahead of the upload, so files can be inflated and transcoded in parallel
+            struct KtxImage
+            {
+                ktxTexture* texture = nullptr;
+                VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+            };
+            static auto open_ktx(const tinygltf::Image& gltf_image, const std::string& path, uka::Uka_Device* device) -> KtxImage;
+            // Records the upload into batch, the texture is usable once the batch was submitted. Takes ownership of
+            // ktx_image, KTX images without one are opened here.
+            auto from_gltf_image(const tinygltf::Image& gltf_image, std::string path, uka::Uka_Device* device, Uka_Upload_Batch& batch, KtxImage ktx_image = {}) -> void;
+            // Upper bound of the staging bytes from_gltf_image takes from a batch, alignment included. KTX2 images
+            // need their opened ktx_image, their data can outgrow the file.
+            static auto staging_size(const tinygltf::Image& gltf_image, const std::string& path, const KtxImage& ktx_image = {}) -> VkDeviceSize;
+            // Creates an image of mip_levels levels and records the upload of [resident_level, mip_levels) from data,
+            // level i in [level_offsets[i], level_offsets[i + 1]). Levels above resident_level stay undefined until streamed.
+            auto from_levels(const uint8_t* data, const size_t* level_offsets, VkFormat format, uint32_t width, uint32_t height, uint32_t mip_levels, uint32_t resident_level, uka::Uka_Device* device, Uka_Upload_Batch& batch) -> void;
+            auto create_sampler() -> void;
+            // (Re)creates image_view over [resident_level, mip_levels) and updates descriptor
+            auto create_view() -> void;
         };
 
         struct Material
@@ -64,7 +143,7 @@ namespace uka
                 APLHA_OPAQUE,
                 APLHA_MASK,
                 APLHA_BLEND
-            } alpha_mode;
+            } alpha_mode = APLHA_OPAQUE;
             AlphaMode alpha_mode_enum = AlphaMode::APLHA_OPAQUE;
             float alpha_cutoff = 1.0f;
             float metallic_factor = 1.0f;
@@ -81,6 +160,8 @@ namespace uka
             VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
             Material(uka::Uka_Device* device) : device(device) {}
             auto create_descriptor_set(VkDescriptorPool descriptor_pool,VkDescriptorSetLayout descriptor_set_layout,uint32_t descriptor_binding_flags) -> void;
+            // Rewrites descriptor_set from the textures' current descriptors
+            auto update_descriptor_set(uint32_t descriptor_binding_flags) -> void;
         };
 
         struct Primitive
@@ -89,6 +170,23 @@ namespace uka
             uint32_t index_count;
             uint32_t first_vertex;
             uint32_t vertex_count;
+            uint32_t material_index = 0;
+            // Added to every index at draw time, non-zero when indices are stored relative to the primitive
+            int32_t vertex_offset = 0;
+            // Added on top of vertex_offset when drawing from Model::skinning.output
+            int32_t skinned_vertex_offset = 0;
+            // Range in Model::meshlets, empty unless loaded with BUILD_MESHLETS
+            uint32_t first_meshlet = 0;
+            uint32_t meshlet_count = 0;
+
+            // Simplified index ranges, coarsest last. error is the largest distance of a full mesh vertex from the level in model units.
+            struct Lod
+            {
+                uint32_t first_index;
+                uint32_t index_count;
+                float error;
+            };
+            std::vector<Lod> lods;
             Material material;
 
             struct Dimensions
@@ -100,6 +198,13 @@ namespace uka
                 float radius;
             } dimensions;
 
+            // position = offset + unorm_position * scale when positions are COMPRESS_POSITION_UNORM16
+            struct Dequantization
+            {
+                glm::vec4 offset = glm::vec4(0.0f);
+                glm::vec4 scale = glm::vec4(1.0f);
+            } dequantization;
+
             auto set_dimensions(const glm::vec3& min, const glm::vec3& max) -> void;
             Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : first_index(firstIndex), index_count(indexCount), material(material) {};
         };
@@ -107,27 +212,54 @@ namespace uka
         struct Mesh
         {
             std::vector<Primitive*> primitives;
-            uka::Uka_Device* device;
             std::string name;
+        };
 
-            struct UniformBuffer
-            {
-                VkBuffer buffer;
-                VkDeviceMemory memory;
-                VkDescriptorBufferInfo descriptor;
-                VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
-                void *mapped;
-            } uniform_buffer;
+        // Per mesh node record in Model::transforms (std430), joints index the frame's joint matrix array
+        struct MeshTransform
+        {
+            glm::mat4 matrix{1.0f};
+            uint32_t first_joint = 0;
+            uint32_t joint_count = 0;
+            uint32_t padding[2] = {};
+        };
 
-            struct UniformBlock
-            {
-                glm::mat4 matrix;
-                glm::mat4 joint_matrix[64];
-                float joint_count{0};
-            } uniform_block;
+        // Per material record of Model::bindless (std430). Texture indices address the bindless image array, -1 is none.
+        struct MaterialData
+        {
+            glm::vec4 base_color_factor = glm::vec4(1.0f);
+            float metallic_factor = 1.0f;
+            float roughness_factor = 1.0f;
+            float alpha_cutoff = 1.0f;
+            uint32_t alpha_mode = 0;
+            int32_t base_color_texture = -1;
+            int32_t metallic_roughness_texture = -1;
+            int32_t normal_texture = -1;
+            int32_t occlusion_texture = -1;
+            int32_t emissive_texture = -1;
+            uint32_t padding[3] = {};
+        };
 
-            Mesh(uka::Uka_Device* device,glm::mat4 matrix);
-            ~Mesh();
+        // Per draw record of Model::indirect (std430), the vertex shader reads it at SV_StartInstanceLocation
+        struct DrawData
+        {
+            glm::vec4 dequantization_offset = glm::vec4(0.0f);
+            glm::vec4 dequantization_scale = glm::vec4(1.0f);
+            uint32_t transform_index = 0;
+            uint32_t material_index = 0;
+            uint32_t padding[2] = {};
+        };
+
+        // Per indirect draw input of the GPU culling pass (std430), local box and where survivors go
+        struct CullRecord
+        {
+            glm::vec3 center{0.0f};
+            uint32_t transform_index = 0;
+            glm::vec3 extent{0.0f};
+            uint32_t group = 0;
+            uint32_t group_first_command = 0;
+            uint32_t always_visible = 0;
+            uint32_t padding[2] = {};
         };
 
         struct Skin
@@ -150,11 +282,28 @@ namespace uka
             glm::quat rotation{};
             std::string name;
             uint32_t index;
+            // Position in Model::linear_nodes, parents come before their children
+            uint32_t linear_index = 0;
             int32_t skin_index = -1;
-            auto update() -> void;
+            // Range in Model::joint_matrices for skinned mesh nodes
+            uint32_t first_joint = 0;
+            // Record in Model::mesh_transforms for mesh nodes
+            uint32_t transform_index = 0;
+            // Cached by Model::update_transforms
+            glm::mat4 world_matrix{1.0f};
+            // Local TRS changed since the last update_transforms, set through mark_dirty
+            bool dirty = true;
+            // Some descendant is dirty
+            bool subtree_dirty = true;
+            // update_transforms generation in which world_matrix last changed
+            uint64_t world_generation = 0;
+            // Call after editing translation/rotation/scale
+            auto mark_dirty() -> void;
+            // Writes world_matrix to transform and the skin's joint matrices to joint_matrices
+            auto update_mesh_transform(MeshTransform& transform, glm::mat4* joint_matrices) -> void;
             auto local_matrix_from_node() -> glm::mat4;
+            // Walks the parent chain, use world_matrix unless the cache may be stale
             auto get_matrix() -> glm::mat4;
-            ~Node();
         };
 
         struct AnimationChannel
@@ -179,6 +328,9 @@ namespace uka
             } interpolation;
             std::vector<float> inputs;
             std::vector<glm::vec4> outputs;
+            // Finds key such that inputs[key] <= time <= inputs[key + 1], starting from cursor and updating it.
+            // Returns false if time lies outside the sampler's range.
+            auto find_key(float time, uint32_t& cursor) const -> bool;
         };
 
         struct Animation
@@ -186,8 +338,8 @@ namespace uka
             std::string name;
             std::vector<AnimationSampler> samplers;
             std::vector<AnimationChannel> channels;
-            float start;
-            float end;
+            float start = std::numeric_limits<float>::max();
+            float end = std::numeric_limits<float>::lowest();
 
         };
 
@@ -202,6 +354,25 @@ namespace uka
             WEIGHTS = 0x00000006,
         };
 
+        // Separate vertex streams, each bound to the binding of the same index
+        enum VertexStreamFlags
+        {
+            STREAM_POSITION = 0x00000001,
+            STREAM_SHADING = 0x00000002,
+            STREAM_SKINNING = 0x00000004,
+            STREAM_ALL = 0x00000007,
+        };
+
+        struct VertexLayout
+        {
+            uint32_t stride;
+            // Offsets are relative to the start of the component's stream element
+            uint32_t offsets[7];
+            VkFormat formats[7];
+            uint32_t streams[7];
+            uint32_t stream_strides[3];
+        };
+
         struct Vertex
         {
             glm::vec3 position;
@@ -214,10 +385,15 @@ namespace uka
             static VkVertexInputBindingDescription vertex_input_binding_description;
             static std::vector<VkVertexInputAttributeDescription> vertex_input_attribute_descriptions;
             static VkPipelineVertexInputStateCreateInfo pipeline_vertex_input_state_create_info;
+            // Byte layout of the uploaded vertex buffer for the given VertexCompression flags
+            static auto layout(uint32_t compression = vertex_compression, bool split_streams = false) -> VertexLayout;
+            static auto stream_of(VertexComponent component) -> uint32_t;
             static auto input_binding_description(uint32_t biding) -> VkVertexInputBindingDescription;
             static auto input_attribute_description(uint32_t binding, uint32_t location, VertexComponent component) -> VkVertexInputAttributeDescription;
             static auto input_attribute_descriptions(uint32_t binding,const std::vector<VertexComponent> components) -> std::vector<VkVertexInputAttributeDescription>;
             static auto pipeline_vertex_input_state(const std::vector<VertexComponent> components) -> VkPipelineVertexInputStateCreateInfo*;
+            // Declares one binding per stream the components live in, for models loaded with SPLIT_VERTEX_STREAMS
+            static auto pipeline_vertex_input_state_split(const std::vector<VertexComponent> components) -> VkPipelineVertexInputStateCreateInfo*;
         };
 
         enum LoadFlags
@@ -227,6 +403,38 @@ namespace uka
             PRE_MULTIPLY_VERTEX_COLORS = 0x00000002,
             FLIP_Y = 0x00000004,
             DONT_LOAD_IMAGES = 0x00000008,
+            MEMORY_MAP_BUFFERS = 0x00000010,
+            // Reuses decoded, welded, optimized and simplified geometry from a cache file keyed on the asset and buffer stamps.
+            // The glTF is still parsed and every buffer still read in full, skins, animations and buffer view images need them.
+            CACHE_GEOMETRY = 0x00000020,
+            SPLIT_VERTEX_STREAMS = 0x00000040,
+            // Vertex cache and vertex fetch order, plus 16-bit indices when every primitive fits
+            OPTIMIZE_MESHES = 0x00000080,
+            // Additionally sorts cache clusters outside-in to reduce overdraw, implies OPTIMIZE_MESHES
+            OPTIMIZE_OVERDRAW = 0x00000100,
+            // Splits primitives into 64 vertex / 124 triangle meshlets with bounds for draw_culled
+            BUILD_MESHLETS = 0x00000200,
+            // Quadric-error simplified LOD chain per primitive for draw_lod
+            GENERATE_LODS = 0x00000400,
+            // Merges duplicate vertices per primitive within weld_tolerances before any other geometry stage
+            WELD_VERTICES = 0x00000800,
+            // Skinned primitives get a slot in an output vertex buffer that a compute pre-pass skins into, see Model::prepare_skinning.
+            // Needs uncompressed interleaved vertices.
+            GPU_SKINNING = 0x00001000,
+            // Every texture in one descriptor array and every material in a storage buffer, bound once as Model::bindless
+            // instead of a descriptor set per material. Needs the descriptor indexing features (runtimeDescriptorArray,
+            // shaderSampledImageArrayNonUniformIndexing, descriptorBindingPartiallyBound, descriptorBindingVariableDescriptorCount,
+            // descriptorBindingSampledImageUpdateAfterBind).
+            BINDLESS_MATERIALS = 0x00002000,
+            // Uploads only the mip tail of every image with the model, the larger levels follow on the transfer queue
+            // through Model::update_texture_streaming
+            STREAM_TEXTURES = 0x00004000,
+        };
+
+        struct PrimitiveLoadJob
+        {
+            const tinygltf::Primitive* source;
+            Primitive* primitive;
         };
 
         enum VkRenderingFlags
@@ -235,6 +443,43 @@ namespace uka
             RENDER_OPAQUE_NODES = 0x00000002,
             RENDER_ALPHA_MASKED_NODES = 0x00000004,
             RENDER_ALPHA_BLENDED_NODES = 0x00000008,
+            // Push Primitive::dequantization to the vertex stage at offset 0 for compressed positions
+            PUSH_POSITION_DEQUANTIZATION = 0x00000010,
+            // Pushes Node::transform_index as a uint at offset sizeof(Primitive::Dequantization) to the vertex stage
+            PUSH_TRANSFORM_INDEX = 0x00000020,
+            // Pushes Primitive::material_index as a uint at offset sizeof(Primitive::Dequantization) + 4 to the fragment stage
+            PUSH_MATERIAL_INDEX = 0x00000040,
+        };
+
+        // One primitive of one node, produced by Model::build_render_queue
+        struct DrawPacket
+        {
+            // Sorts by pipeline (alpha mode, skinned), then material and depth, see build_render_queue
+            uint64_t key;
+            const Node* node;
+            const Primitive* primitive;
+        };
+
+        struct PrimitiveInstance
+        {
+            const Node* node;
+            const Primitive* primitive;
+        };
+
+        // Reusable per pass, so the packet arrays only allocate while the scene grows
+        struct RenderQueue
+        {
+            std::vector<DrawPacket> packets;
+            std::vector<DrawPacket> scratch;
+            // Frustum test result per Model::primitive_instances entry, and the counts of the primitives the
+            // RENDER_* flags selected
+            std::vector<uint8_t> visibility;
+            uka::culling::Statistics culling;
+            // State changes of the last draw_queue call
+            uint32_t draws = 0;
+            uint32_t descriptor_binds = 0;
+            uint32_t vertex_buffer_binds = 0;
+            uint32_t push_constants = 0;
         };
 
         struct Model
@@ -243,6 +488,78 @@ namespace uka
             auto get_texture(uint32_t index) -> Texture*;
             Texture empty_texture;
             auto create_empty_texture(VkQueue queue) -> void;
+
+            // Base pointer of every glTF buffer during loading, either tinygltf's copy or a file mapping
+            std::vector<const unsigned char*> buffer_data;
+            std::vector<uka::Uka_Mapped_File> mapped_files;
+            static auto read_mapped_file(std::vector<unsigned char>* out, std::string* err, const std::string& file_path, void* user_data) -> bool;
+            auto bind_buffer_data(tinygltf::Model& gltf_model, bool binary) -> void;
+            auto accessor_data(const tinygltf::Model& model, const tinygltf::Accessor& accessor) const -> const unsigned char*;
+            auto attribute_data(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* name, size_t& stride, const tinygltf::Accessor** accessor_out = nullptr) const -> const unsigned char*;
+
+            auto geometry_cache_key(const std::string& filename, const tinygltf::Model& gltf_model, uint32_t file_loading_flags, float scale) const -> std::string;
+            auto geometry_cache_path(const std::string& filename) const -> std::string;
+            auto read_geometry_cache(const uka::Uka_Mapped_File& cache, const std::string& key, const std::vector<PrimitiveLoadJob>& primitive_jobs, const Vertex** vertex_data, uint32_t& vertex_count, const uint32_t** index_data, uint32_t& index_count) -> bool;
+            auto pack_vertices(const Vertex* vertex_data, uint32_t vertex_count, const std::vector<PrimitiveLoadJob>& primitive_jobs, const VertexLayout& vertex_layout) -> std::vector<unsigned char>;
+            auto build_meshlets(const std::vector<PrimitiveLoadJob>& primitive_jobs, const Vertex* vertex_data, const uint32_t* index_data) -> void;
+            auto draw_primitive(const Node* node, const Primitive* primitive, VkCommandBuffer commandbuffer) -> void;
+            struct MeshletCulling
+            {
+                uka::Uka_Frustum frustum;
+                glm::vec3 eye;
+            };
+            // Set while draw_culled records
+            const MeshletCulling* meshlet_culling = nullptr;
+
+            auto generate_lods(const std::vector<PrimitiveLoadJob>& primitive_jobs, std::vector<uint32_t>& index_buffer, const std::vector<Vertex>& vertex_buffer) -> void;
+            struct LodSelection
+            {
+                glm::vec3 eye;
+                // Pixels per model unit at distance 1
+                float pixels_per_unit;
+                float pixel_error;
+            };
+            // Set while draw_lod records
+            const LodSelection* lod_selection = nullptr;
+            // Queue draw records through, rebuilt on every call
+            RenderQueue render_queue;
+            uka::animation::Pose animated_pose;
+            uint64_t transform_generation = 0;
+            // Push constants of skinning.slang
+            struct SkinningDispatch
+            {
+                uint32_t first_vertex;
+                uint32_t vertex_count;
+                uint32_t first_joint;
+                uint32_t output_first_vertex;
+            };
+            uka::Uka_Arena scene_arena;
+            // glTF node index -> loaded node, null for nodes outside the loaded scene
+            std::vector<Node*> node_lookup;
+            auto apply_pose(const uka::animation::Pose& pose) -> void;
+            auto select_lod(const glm::mat4& world_matrix, const Primitive* primitive) const -> const Primitive::Lod*;
+
+            // Push constants of culling.slang
+            struct CullingView
+            {
+                glm::vec4 planes[6];
+                uint32_t draw_count;
+                uint32_t compact;
+                uint32_t padding[2];
+            };
+            // Uniform of culling.slang's occlusion set (std140)
+            struct OcclusionParams
+            {
+                glm::mat4 view_projection;
+                glm::vec2 size;
+                uint32_t mip_levels;
+                uint32_t padding;
+            };
+            auto prepare_bindless(VkQueue transfer_queue) -> void;
+            // The set BIND_IMAGES binds for a material
+            auto material_descriptor_set(uint32_t material_index) const -> VkDescriptorSet;
+            auto draw_indirect_groups(VkCommandBuffer commandbuffer, VkBuffer buffer, VkDeviceSize commands_offset, VkDeviceSize counts_offset, uint32_t render_flags, uint32_t vertex_streams) -> void;
+            auto write_geometry_cache(const std::string& cache_path, const std::string& key, const std::vector<PrimitiveLoadJob>& primitive_jobs, const std::vector<Vertex>& vertex_buffer, const std::vector<uint32_t>& index_buffer) -> void;
         public:
             uka::Uka_Device* device;
             VkDescriptorPool descriptor_pool;
@@ -251,21 +568,181 @@ namespace uka
                 int count;
                 VkBuffer buffer;
                 VkDeviceMemory memory;
+                // Streams share the buffer back to back when split
+                bool split_streams = false;
+                VkDeviceSize stream_offsets[3] = {0, 0, 0};
             } vertices;
             struct Indices
             {
                 int count;
                 VkBuffer buffer;
                 VkDeviceMemory memory;
+                VkIndexType type = VK_INDEX_TYPE_UINT32;
             } indices;
 
+            // Post-transform cache statistics over all primitives, before and after OPTIMIZE_MESHES
+            struct OptimizationStatistics
+            {
+                uka::mesh::VertexCacheStatistics before;
+                uka::mesh::VertexCacheStatistics after;
+            } optimization_statistics;
+
+            // Vertex counts before and after WELD_VERTICES
+            struct WeldStatistics
+            {
+                uint32_t vertices_before = 0;
+                uint32_t vertices_after = 0;
+            } weld_statistics;
+
             std::vector<Node*> nodes;
+            // Every node in depth-first order, nodes, meshes, primitives and skins live in scene_arena
             std::vector<Node*> linear_nodes;
 
             std::vector<Skin*> skins;
             std::vector<Texture> textures;
             std::vector<Material> materials;
             std::vector<Animation> animations;
+            // animations in structure of arrays form for the SIMD runtime, targets index linear_nodes
+            std::vector<uka::animation::Clip> animation_clips;
+            // Playback state of updateAnimation, one per clip
+            std::vector<uka::animation::ClipCursor> animation_cursors;
+            // Local transforms of linear_nodes as loaded, fills targets a blend leaves under full weight
+            uka::animation::Pose rest_pose;
+            std::vector<uka::mesh::Meshlet> meshlets;
+            // Joint matrices of all skinned mesh nodes, relative to the node, refreshed by update_transforms
+            std::vector<glm::mat4> joint_matrices;
+            std::vector<MeshTransform> mesh_transforms;
+            // Every primitive of every mesh node in linear_nodes order, with its model space box in primitive_bounds.
+            // Boxes follow update_transforms, skinned primitives get unbounded boxes and are never culled.
+            std::vector<PrimitiveInstance> primitive_instances;
+            uka::culling::Bounds primitive_bounds;
+
+            // mesh_transforms followed by joint_matrices, once per frame in flight in one persistently mapped buffer.
+            // Replaces a uniform buffer and descriptor set per mesh.
+            struct Transforms
+            {
+                VkBuffer buffer = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                unsigned char* mapped = nullptr;
+                // Both aligned to minStorageBufferOffsetAlignment
+                VkDeviceSize frame_size = 0;
+                VkDeviceSize joints_offset = 0;
+                VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+                // transform_generation last copied into each frame's range
+                std::vector<uint64_t> uploaded_generation;
+            } transforms;
+
+            // Compute pre-pass for GPU_SKINNING. Skinned vertices are written once per frame and every pass draws them.
+            // vertex_count stays 0 when the vertices were packed, skinning then stays in the vertex shader.
+            struct Skinning
+            {
+                uint32_t vertex_count = 0;
+                VkBuffer output = VK_NULL_HANDLE;
+                VkDeviceMemory output_memory = VK_NULL_HANDLE;
+                VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+                VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+                std::vector<VkDescriptorSet> descriptor_sets;
+                VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+                VkPipeline pipeline = VK_NULL_HANDLE;
+            } skinning;
+
+            // Set when loaded with BINDLESS_MATERIALS. BIND_IMAGES then binds descriptor_set once for all materials.
+            struct Bindless
+            {
+                VkBuffer materials = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                // textures followed by empty_texture
+                uint32_t texture_count = 0;
+                // Update after bind pool, so texture streaming can rewrite elements of a set pending frames use
+                VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+                VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+            } bindless;
+
+            // Set when loaded with STREAM_TEXTURES. Each update copies the next larger level of every streaming
+            // texture on the transfer queue and swaps the finished ones into image_view once their copy completed.
+            struct TextureStreaming
+            {
+                struct Source
+                {
+                    uint32_t texture;
+                    // Texel data of every level, level i in [level_offsets[i], level_offsets[i + 1])
+                    std::vector<uint8_t> data;
+                    std::vector<size_t> level_offsets;
+                };
+                std::vector<Source> sources;
+                VkQueue queue = VK_NULL_HANDLE;
+                VkCommandPool command_pool = VK_NULL_HANDLE;
+                std::unique_ptr<Uka_Upload_Batch> batch;
+                // Textures and levels the batch is copying
+                std::vector<std::pair<uint32_t, uint32_t>> in_flight;
+                // Views and material sets a swap replaced, released frames_in_flight updates later
+                struct Retired
+                {
+                    VkImageView image_view = VK_NULL_HANDLE;
+                    VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+                    uint64_t update = 0;
+                };
+                std::vector<Retired> retired;
+                uint64_t update_count = 0;
+            } texture_streaming;
+
+            // Indirect commands of every mesh primitive, grouped by alpha mode and skinning so a whole model is one
+            // draw call per group. Built once by prepare_indirect, static scenes reuse it every frame.
+            struct Indirect
+            {
+                // Group of alpha mode a and skinned s is a * 2 + s
+                static constexpr uint32_t group_count = 6;
+                VkBuffer buffer = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                // buffer holds a uint32_t draw count per group at offset 0, the VkDrawIndexedIndirectCommand array at
+                // commands_offset and DrawData at draw_data_offset. firstInstance of every command indexes DrawData.
+                VkDeviceSize commands_offset = 0;
+                VkDeviceSize draw_data_offset = 0;
+                uint32_t draw_count = 0;
+                uint32_t first_command[group_count] = {};
+                uint32_t command_count[group_count] = {};
+                PFN_vkCmdDrawIndexedIndirectCount draw_indexed_indirect_count = nullptr;
+                // Node and primitive of every command
+                std::vector<PrimitiveInstance> instances;
+            } indirect;
+
+            // Compute pass testing every indirect draw against a frustum per view and compacting the survivors into
+            // the view's own commands, see prepare_gpu_culling
+            struct GpuCulling
+            {
+                uint32_t view_count = 0;
+                VkBuffer records = VK_NULL_HANDLE;
+                VkDeviceMemory records_memory = VK_NULL_HANDLE;
+                // A region per frame in flight and view, region frame * view_count + view. Each holds a draw count per
+                // Indirect group followed by the commands at commands_offset, laid out like Model::indirect.
+                VkBuffer output = VK_NULL_HANDLE;
+                VkDeviceMemory output_memory = VK_NULL_HANDLE;
+                VkDeviceSize commands_offset = 0;
+                VkDeviceSize region_size = 0;
+                VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+                VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+                std::vector<VkDescriptorSet> descriptor_sets;
+                VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                // mainOcclusion variant with set 1 holding a Hi-Z pyramid and its OcclusionParams, one set per frame
+                VkPipeline occlusion_pipeline = VK_NULL_HANDLE;
+                VkDescriptorSetLayout occlusion_set_layout = VK_NULL_HANDLE;
+                std::vector<VkDescriptorSet> occlusion_sets;
+                // Pyramid view each occlusion set was last written with
+                std::vector<VkImageView> occlusion_views;
+                VkBuffer occlusion_buffer = VK_NULL_HANDLE;
+                VkDeviceMemory occlusion_memory = VK_NULL_HANDLE;
+                unsigned char* occlusion_mapped = nullptr;
+                VkDeviceSize occlusion_stride = 0;
+            } gpu_culling;
+
+            // Meshlet counts of the last draw_culled call
+            struct CullingStatistics
+            {
+                uint32_t visible = 0;
+                uint32_t frustum_culled = 0;
+                uint32_t backface_culled = 0;
+            } culling_statistics;
 
             struct Dimensions
             {
@@ -276,27 +753,81 @@ namespace uka
                 float radius;
             } dimensions;
 
+            // VertexCompression flags the vertex buffer was packed with
+            uint32_t vertex_compression_flags = COMPRESS_NONE;
+
             bool metallic_roughness_workflow = true;
             bool buffers_bound = false;
             std::string path;
 
             Model(){};
             ~Model();
-            auto load_node(Node* parent, const tinygltf::Node& node, uint32_t node_index, const tinygltf::Model& model, std::vector<uint32_t>& index_buffer, std::vector<Vertex>& vertex_buffer, float global_scale) ->void;
+            auto load_node(Node* parent, const tinygltf::Node& node, uint32_t node_index, const tinygltf::Model& model, std::vector<PrimitiveLoadJob>& primitive_jobs, uint32_t& vertex_count, uint32_t& index_count, float global_scale) ->void;
+            auto load_primitive(const tinygltf::Model& model, const PrimitiveLoadJob& job, std::vector<uint32_t>& index_buffer, std::vector<Vertex>& vertex_buffer) ->void;
+            auto weld_vertices(const std::vector<PrimitiveLoadJob>& primitive_jobs, std::vector<uint32_t>& index_buffer, std::vector<Vertex>& vertex_buffer) -> void;
+            auto optimize_meshes(const std::vector<PrimitiveLoadJob>& primitive_jobs, std::vector<uint32_t>& index_buffer, std::vector<Vertex>& vertex_buffer, bool optimize_overdraw) ->void;
             auto load_skins(tinygltf::Model& gltf_model) ->void;
-            auto load_image(tinygltf::Model& gltf_model, uka::Uka_Device* device, VkQueue transfer_queue) ->void;
+            auto load_image(tinygltf::Model& gltf_model, uka::Uka_Device* device, VkQueue transfer_queue, uint32_t file_loading_flags = LoadFlags::NONE) ->void;
             auto load_materials(tinygltf::Model& gltf_model) ->void;
             auto load_animations(tinygltf::Model& gltf_model) ->void;
             auto load_form_file(std::string filename, uka::Uka_Device* device, VkQueue transfer_queue, uka::gltf::LoadFlags file_loading_flags = LoadFlags::NONE, float scale = 1.0f) ->void;
-            auto bind_buffers(VkCommandBuffer commandbuffer) ->void;
+            auto bind_buffers(VkCommandBuffer commandbuffer, uint32_t vertex_streams = STREAM_ALL) ->void;
             auto draw_node(Node* node, VkCommandBuffer commandbuffer, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1) ->void;
-            auto draw(VkCommandBuffer commandbuffer, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1) ->void;
+            auto draw(VkCommandBuffer commandbuffer, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1, uint32_t vertex_streams = STREAM_ALL) ->void;
+            // Like draw, but primitives with meshlets only draw the clusters inside the frustum and facing the eye.
+            // frustum and eye live in model space, the space node matrices map into (build the frustum from projection * view * model).
+            auto draw_culled(VkCommandBuffer commandbuffer, const uka::Uka_Frustum& frustum, const glm::vec3& eye, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1, uint32_t vertex_streams = STREAM_ALL) ->void;
+            // Like draw, but every primitive uses the coarsest LOD whose error projects below pixel_error pixels.
+            // eye lives in model space, projection is the camera projection (Uka_Camera::matrices.perspective).
+            auto draw_lod(VkCommandBuffer commandbuffer, const glm::vec3& eye, const glm::mat4& projection, float viewport_height, float pixel_error = 1.0f, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1, uint32_t vertex_streams = STREAM_ALL) ->void;
+            // Fills queue with the primitives of every mesh node that pass the RENDER_* flags (all of them when none is set)
+            // and the optional frustum (build it from the camera or light view-projection times the model matrix), sorted by pipeline and material. Within a material opaque and masked primitives go
+            // front to back, blended ones back to front. eye and frustum live in model space.
+            auto build_render_queue(RenderQueue& queue, const glm::vec3& eye, uint32_t render_flags = 0, const uka::Uka_Frustum* frustum = nullptr) const -> void;
+            // Tests primitive_bounds against a model space frustum, one visibility entry per primitive_instances entry
+            auto cull(const uka::Uka_Frustum& frustum, std::vector<uint8_t>& visibility) const -> uka::culling::Statistics;
+            // Records a built queue, descriptor sets, vertex buffers and push constants are only set when they change
+            auto draw_queue(VkCommandBuffer commandbuffer, RenderQueue& queue, uint32_t render_flags = 0, VkPipelineLayout pipeline_layout = VK_NULL_HANDLE, uint32_t bind_image_set = 1, uint32_t vertex_streams = STREAM_ALL) -> void;
             auto get_node_dimensions(Node* node, glm::vec3& min, glm::vec3& max) ->void;
             auto get_scene_dimensions() ->void;
             auto updateAnimation(uint32_t index, float time) ->void;
+            // Recomputes world matrices of dirty subtrees top-down and refreshes the affected mesh uniforms.
+            // Costs nothing beyond a flag check per root when no node was marked dirty.
+            auto update_transforms() -> void;
+            // Copies mesh_transforms and joint_matrices into the frame's range once its previous use has finished,
+            // ranges that are already current are skipped
+            auto upload_transforms(uint32_t frame_index) -> void;
+            // Binds the frame's range as descriptor_set_layout_transforms
+            auto bind_transforms(VkCommandBuffer commandbuffer, VkPipelineLayout pipeline_layout, uint32_t set, uint32_t frame_index, VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS) -> void;
+            // Creates the skinning pipeline from compiled skinning.slang. Does nothing unless loaded with GPU_SKINNING.
+            auto prepare_skinning(const std::string& shader_file, VkPipelineCache pipeline_cache = VK_NULL_HANDLE) -> void;
+            // Skins every skinned primitive with the frame's joint matrices, record after upload_transforms and
+            // before any pass draws the model
+            auto record_skinning(VkCommandBuffer commandbuffer, uint32_t frame_index) -> void;
+            // Builds the indirect buffer and binds its DrawData as binding 2 of transforms.descriptor_set. Call after
+            // prepare_skinning, needs the drawIndirectFirstInstance feature.
+            auto prepare_indirect(VkQueue transfer_queue) -> void;
+            // Draws the groups the RENDER_* flags select (all when none is set) from the indirect buffer. Full detail
+            // primitives only, images and per-primitive push constants are left to the shader through DrawData.
+            auto draw_indirect(VkCommandBuffer commandbuffer, uint32_t render_flags = 0, uint32_t vertex_streams = STREAM_ALL) -> void;
+            // Creates the culling pipeline from compiled culling.slang for up to view_count frusta per frame, e.g. the
+            // camera and every shadow casting light. Call after prepare_indirect.
+            auto prepare_gpu_culling(const std::string& shader_file, VkQueue transfer_queue, uint32_t view_count, VkPipelineCache pipeline_cache = VK_NULL_HANDLE) -> void;
+            // Culls against model space frusta, one per view. Record after upload_transforms and outside a render pass,
+            // before the passes that draw the views. With a built hiz, view 0 also drops draws hidden behind the
+            // pyramid's depth, model_matrix maps the model into the space of hiz->view_projection.
+            auto record_gpu_culling(VkCommandBuffer commandbuffer, uint32_t frame_index, const uka::Uka_Frustum* frusta, uint32_t frustum_count, const uka::Uka_Hiz* hiz = nullptr, const glm::mat4& model_matrix = glm::mat4(1.0f)) -> void;
+            // Like draw_indirect, with the commands that survived the view's frustum
+            auto draw_gpu_culled(VkCommandBuffer commandbuffer, uint32_t frame_index, uint32_t view, uint32_t render_flags = 0, uint32_t vertex_streams = STREAM_ALL) -> void;
+            // Swaps levels whose copy finished into the textures and submits the next ones. Call once per frame after
+            // waiting for the frame's fence: replaced views and material descriptor sets stay alive for frames_in_flight
+            // further calls. Returns true while streaming or while replaced objects are pending release.
+            auto update_texture_streaming() -> bool;
+            // Blends layers over rest_pose and writes the result to every node, layers may reference clips of another
+            // model loaded from the same file
+            auto blend_animations(const uka::animation::Layer* layers, size_t layer_count) -> void;
             auto find_node(Node* parent, uint32_t index) -> Node*;
             auto node_from_index(uint32_t index) -> Node*;
-            auto prepare_node_descriptor_set(Node* node,VkDescriptorSetLayout descriptor_set_layout) ->void;
         };
     };
 }
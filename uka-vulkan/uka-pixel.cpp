@@ -0,0 +1,400 @@
+#include "uka-pixel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UKA_PIXEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC compiles any intrinsic without per-function targets
+#define UKA_PIXEL_TARGET(isa)
+#else
+#define UKA_PIXEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace uka
+{
+    namespace pixel
+    {
+        namespace
+        {
+            // sRGB byte -> linear float
+            auto srgb_decode_table() -> const std::array<float, 256>&
+            {
+                static const auto table = []
+                {
+                    auto values = std::array<float, 256>{};
+                    for(auto i = 0; i < 256; i++)
+                    {
+                        const auto c = i / 255.0;
+                        values[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+                    }
+                    return values;
+                }();
+                return table;
+            }
+
+            // Linear value quantized to 16 bits -> sRGB byte, fine enough to match the exact encode for all but
+            // values right at a rounding boundary. Every path uses it, so they agree bit for bit.
+            auto srgb_encode_table() -> const std::array<uint8_t, 65536>&
+            {
+                static const auto table = []
+                {
+                    auto values = std::array<uint8_t, 65536>{};
+                    for(auto i = 0; i < 65536; i++)
+                    {
+                        const auto l = i / 65535.0;
+                        const auto c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+                        values[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.0, 1.0) * 255.0));
+                    }
+                    return values;
+                }();
+                return table;
+            }
+
+            inline auto encode_index(float value) -> uint32_t
+            {
+                return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+            }
+
+            inline auto encode_alpha(float value) -> uint8_t
+            {
+                return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+
+            // Exact round(c * a / 255) without a division
+            inline auto premultiply(uint32_t c, uint32_t a) -> uint8_t
+            {
+                const auto t = c * a + 128;
+                return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+            }
+
+            // Scalar kernels finish the tails of the SIMD ones
+
+            auto rgb_to_rgba_scalar(const uint8_t* rgb, uint8_t* rgba, size_t count, uint8_t alpha) -> void
+            {
+                for(auto i = size_t{0}; i < count; i++)
+                {
+                    rgba[i * 4 + 0] = rgb[i * 3 + 0];
+                    rgba[i * 4 + 1] = rgb[i * 3 + 1];
+                    rgba[i * 4 + 2] = rgb[i * 3 + 2];
+                    rgba[i * 4 + 3] = alpha;
+                }
+            }
+
+            auto premultiply_alpha_scalar(const uint8_t* rgba, uint8_t* destination, size_t count) -> void
+            {
+                for(auto i = size_t{0}; i < count; i++)
+                {
+                    const auto a = rgba[i * 4 + 3];
+                    destination[i * 4 + 0] = premultiply(rgba[i * 4 + 0], a);
+                    destination[i * 4 + 1] = premultiply(rgba[i * 4 + 1], a);
+                    destination[i * 4 + 2] = premultiply(rgba[i * 4 + 2], a);
+                    destination[i * 4 + 3] = a;
+                }
+            }
+
+            auto swizzle_scalar(const uint8_t* rgba, uint8_t* destination, size_t count, const uint8_t* channels, uint32_t channel_count) -> void
+            {
+                for(auto i = size_t{0}; i < count; i++)
+                {
+                    for(auto k = uint32_t{0}; k < channel_count; k++)
+                    {
+                        destination[i * channel_count + k] = rgba[i * 4 + channels[k]];
+                    }
+                }
+            }
+
+            auto linear_to_srgb_scalar(const float* linear, uint8_t* rgba, size_t count) -> void
+            {
+                const auto& table = srgb_encode_table();
+                for(auto i = size_t{0}; i < count; i++)
+                {
+                    rgba[i * 4 + 0] = table[encode_index(linear[i * 4 + 0])];
+                    rgba[i * 4 + 1] = table[encode_index(linear[i * 4 + 1])];
+                    rgba[i * 4 + 2] = table[encode_index(linear[i * 4 + 2])];
+                    rgba[i * 4 + 3] = encode_alpha(linear[i * 4 + 3]);
+                }
+            }
+
+#if UKA_PIXEL_X86
+            // pshufb control gathering channels of four texels into 4 * channel_count bytes, the rest zeroed
+            auto swizzle_control(const uint8_t* channels, uint32_t channel_count, uint8_t* control) -> void
+            {
+                for(auto b = 0; b < 16; b++)
+                {
+                    control[b] = 0x80;
+                }
+                for(auto texel = 0u; texel < 4; texel++)
+                {
+                    for(auto k = 0u; k < channel_count; k++)
+                    {
+                        control[texel * channel_count + k] = static_cast<uint8_t>(texel * 4 + channels[k]);
+                    }
+                }
+            }
+
+            UKA_PIXEL_TARGET("ssse3")
+            auto rgb_to_rgba_ssse3(const uint8_t* rgb, uint8_t* rgba, size_t count, uint8_t alpha) -> void
+            {
+                const auto control = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                const auto alpha_mask = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+                auto i = size_t{0};
+                // A 16 byte load covers four texels and one more byte, stop where it would read past the source
+                for(; i * 3 + 16 <= count * 3; i += 4)
+                {
+                    const auto texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(texels, control), alpha_mask));
+                }
+                rgb_to_rgba_scalar(rgb + i * 3, rgba + i * 4, count - i, alpha);
+            }
+
+            // Premultiplies two texels widened to 16 bit channels. Alpha is multiplied by 255, which the rounding
+            // maps back to itself.
+            UKA_PIXEL_TARGET("ssse3")
+            inline auto premultiply_ssse3(__m128i channels) -> __m128i
+            {
+                auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                alpha = _mm_or_si128(_mm_and_si128(alpha, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0)), _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+                const auto t = _mm_add_epi16(_mm_mullo_epi16(channels, alpha), _mm_set1_epi16(128));
+                return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+
+            UKA_PIXEL_TARGET("ssse3")
+            auto premultiply_alpha_ssse3(const uint8_t* rgba, uint8_t* destination, size_t count) -> void
+            {
+                const auto zero = _mm_setzero_si128();
+                auto i = size_t{0};
+                for(; i + 4 <= count; i += 4)
+                {
+                    const auto texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+                    const auto low = premultiply_ssse3(_mm_unpacklo_epi8(texels, zero));
+                    const auto high = premultiply_ssse3(_mm_unpackhi_epi8(texels, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_packus_epi16(low, high));
+                }
+                premultiply_alpha_scalar(rgba + i * 4, destination + i * 4, count - i);
+            }
+
+            UKA_PIXEL_TARGET("ssse3")
+            auto swizzle_ssse3(const uint8_t* rgba, uint8_t* destination, size_t count, const uint8_t* channels, uint32_t channel_count) -> void
+            {
+                alignas(16) uint8_t control_bytes[16];
+                swizzle_control(channels, channel_count, control_bytes);
+                const auto control = _mm_load_si128(reinterpret_cast<const __m128i*>(control_bytes));
+                auto i = size_t{0};
+                // Every store writes 16 bytes of which 4 * channel_count are valid, the next block overwrites the rest
+                for(; i + 4 <= count && i * channel_count + 16 <= count * channel_count; i += 4)
+                {
+                    const auto texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * channel_count), _mm_shuffle_epi8(texels, control));
+                }
+                swizzle_scalar(rgba + i * 4, destination + i * channel_count, count - i, channels, channel_count);
+            }
+
+            UKA_PIXEL_TARGET("ssse3")
+            auto linear_to_srgb_ssse3(const float* linear, uint8_t* rgba, size_t count) -> void
+            {
+                const auto& table = srgb_encode_table();
+                // rgb becomes a 16 bit table index, alpha the final byte
+                const auto scale = _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f);
+                const auto half = _mm_set1_ps(0.5f);
+                const auto zero = _mm_setzero_ps();
+                const auto one = _mm_set1_ps(1.0f);
+                alignas(16) int32_t index[4];
+                for(auto i = size_t{0}; i < count; i++)
+                {
+                    const auto texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(linear + i * 4), zero), one);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(texel, scale), half)));
+                    rgba[i * 4 + 0] = table[index[0]];
+                    rgba[i * 4 + 1] = table[index[1]];
+                    rgba[i * 4 + 2] = table[index[2]];
+                    rgba[i * 4 + 3] = static_cast<uint8_t>(index[3]);
+                }
+            }
+
+            UKA_PIXEL_TARGET("avx2")
+            auto rgb_to_rgba_avx2(const uint8_t* rgb, uint8_t* rgba, size_t count, uint8_t alpha) -> void
+            {
+                const auto control = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                    0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                const auto alpha_mask = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+                auto i = size_t{0};
+                // Each lane loads four texels, the upper lane 12 bytes after the lower
+                for(; i * 3 + 28 <= count * 3; i += 8)
+                {
+                    const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+                    const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3 + 12));
+                    const auto texels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(texels, control), alpha_mask));
+                }
+                rgb_to_rgba_ssse3(rgb + i * 3, rgba + i * 4, count - i, alpha);
+            }
+
+            UKA_PIXEL_TARGET("avx2")
+            inline auto premultiply_avx2(__m256i channels) -> __m256i
+            {
+                auto alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                alpha = _mm256_or_si256(_mm256_and_si256(alpha, _mm256_set1_epi64x(0x0000ffffffffffff)), _mm256_set1_epi64x(0x00ff000000000000));
+                const auto t = _mm256_add_epi16(_mm256_mullo_epi16(channels, alpha), _mm256_set1_epi16(128));
+                return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+            }
+
+            UKA_PIXEL_TARGET("avx2")
+            auto premultiply_alpha_avx2(const uint8_t* rgba, uint8_t* destination, size_t count) -> void
+            {
+                const auto zero = _mm256_setzero_si256();
+                auto i = size_t{0};
+                for(; i + 8 <= count; i += 8)
+                {
+                    // Unpack and pack both work per lane, so the texel order survives the round trip
+                    const auto texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+                    const auto low = premultiply_avx2(_mm256_unpacklo_epi8(texels, zero));
+                    const auto high = premultiply_avx2(_mm256_unpackhi_epi8(texels, zero));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_packus_epi16(low, high));
+                }
+                premultiply_alpha_ssse3(rgba + i * 4, destination + i * 4, count - i);
+            }
+
+            UKA_PIXEL_TARGET("avx2")
+            auto swizzle_avx2(const uint8_t* rgba, uint8_t* destination, size_t count, const uint8_t* channels, uint32_t channel_count) -> void
+            {
+                alignas(16) uint8_t control_bytes[16];
+                swizzle_control(channels, channel_count, control_bytes);
+                const auto control = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(control_bytes)));
+                const auto block = size_t{4} * channel_count;
+                auto i = size_t{0};
+                // Lanes are stored one after the other, the upper one overwrites the lower one's unused bytes
+                for(; i + 8 <= count && i * channel_count + block + 16 <= count * channel_count; i += 8)
+                {
+                    const auto texels = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4)), control);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * channel_count), _mm256_castsi256_si128(texels));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * channel_count + block), _mm256_extracti128_si256(texels, 1));
+                }
+                swizzle_ssse3(rgba + i * 4, destination + i * channel_count, count - i, channels, channel_count);
+            }
+
+            auto cpu_path() -> Path
+            {
+#if defined(_MSC_VER) && !defined(__clang__)
+                int registers[4];
+                __cpuid(registers, 0);
+                const auto max_leaf = registers[0];
+                __cpuid(registers, 1);
+                const auto ssse3 = (registers[2] & (1 << 9)) != 0;
+                const auto osxsave_avx = (registers[2] & (1 << 27)) != 0 && (registers[2] & (1 << 28)) != 0;
+                auto avx2 = false;
+                if(max_leaf >= 7 && osxsave_avx && (_xgetbv(0) & 6) == 6)
+                {
+                    __cpuidex(registers, 7, 0);
+                    avx2 = (registers[1] & (1 << 5)) != 0;
+                }
+#else
+                __builtin_cpu_init();
+                const auto ssse3 = __builtin_cpu_supports("ssse3") != 0;
+                const auto avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+                return avx2 ? Path::avx2 : ssse3 ? Path::ssse3 : Path::scalar;
+            }
+#else
+            auto cpu_path() -> Path
+            {
+                return Path::scalar;
+            }
+#endif
+
+            auto best_path() -> Path
+            {
+                static const auto detected = cpu_path();
+                return detected;
+            }
+
+            std::atomic<Path> active_path{best_path()};
+        }
+
+        auto path() -> Path
+        {
+            return active_path.load(std::memory_order_relaxed);
+        }
+
+        auto path_name(Path kernel_path) -> const char*
+        {
+            switch(kernel_path)
+            {
+                case Path::avx2: return "avx2";
+                case Path::ssse3: return "ssse3";
+                default: return "scalar";
+            }
+        }
+
+        auto force_path(Path kernel_path) -> void
+        {
+            active_path.store(std::min(kernel_path, best_path()), std::memory_order_relaxed);
+        }
+
+        auto rgb_to_rgba(const uint8_t* rgb, uint8_t* rgba, size_t count, uint8_t alpha) -> void
+        {
+            switch(path())
+            {
+#if UKA_PIXEL_X86
+                case Path::avx2: rgb_to_rgba_avx2(rgb, rgba, count, alpha); return;
+                case Path::ssse3: rgb_to_rgba_ssse3(rgb, rgba, count, alpha); return;
+#endif
+                default: rgb_to_rgba_scalar(rgb, rgba, count, alpha); return;
+            }
+        }
+
+        auto premultiply_alpha(const uint8_t* rgba, uint8_t* destination, size_t count) -> void
+        {
+            switch(path())
+            {
+#if UKA_PIXEL_X86
+                case Path::avx2: premultiply_alpha_avx2(rgba, destination, count); return;
+                case Path::ssse3: premultiply_alpha_ssse3(rgba, destination, count); return;
+#endif
+                default: premultiply_alpha_scalar(rgba, destination, count); return;
+            }
+        }
+
+        auto swizzle(const uint8_t* rgba, uint8_t* destination, size_t count, const uint8_t* channels, uint32_t channel_count) -> void
+        {
+            switch(path())
+            {
+#if UKA_PIXEL_X86
+                case Path::avx2: swizzle_avx2(rgba, destination, count, channels, channel_count); return;
+                case Path::ssse3: swizzle_ssse3(rgba, destination, count, channels, channel_count); return;
+#endif
+                default: swizzle_scalar(rgba, destination, count, channels, channel_count); return;
+            }
+        }
+
+        auto srgb_to_linear(const uint8_t* rgba, float* linear, size_t count) -> void
+        {
+            // A table lookup per channel beats any vector evaluation of the transfer function
+            const auto& table = srgb_decode_table();
+            for(auto i = size_t{0}; i < count; i++)
+            {
+                linear[i * 4 + 0] = table[rgba[i * 4 + 0]];
+                linear[i * 4 + 1] = table[rgba[i * 4 + 1]];
+                linear[i * 4 + 2] = table[rgba[i * 4 + 2]];
+                linear[i * 4 + 3] = rgba[i * 4 + 3] * (1.0f / 255.0f);
+            }
+        }
+
+        auto linear_to_srgb(const float* linear, uint8_t* rgba, size_t count) -> void
+        {
+            switch(path())
+            {
+#if UKA_PIXEL_X86
+                case Path::avx2:
+                case Path::ssse3: linear_to_srgb_ssse3(linear, rgba, count); return;
+#endif
+                default: linear_to_srgb_scalar(linear, rgba, count); return;
+            }
+        }
+    }
+}
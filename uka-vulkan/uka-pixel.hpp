@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uka
+{
+    namespace pixel
+    {
+        // Kernel set in use, picked from the CPU's features on first use
+        enum class Path : uint8_t
+        {
+            scalar,
+            ssse3,
+            avx2
+        };
+
+        auto path() -> Path;
+        auto path_name(Path kernel_path) -> const char*;
+        // Caps the kernels at kernel_path, e.g. to compare against scalar. Paths the CPU lacks fall back to the best one it has.
+        auto force_path(Path kernel_path) -> void;
+
+        // All kernels take count texels and may write straight into mapped staging memory. Source and destination
+        // must not overlap unless noted.
+
+        // 3 byte texels to 4 byte texels with a constant alpha
+        auto rgb_to_rgba(const uint8_t* rgb, uint8_t* rgba, size_t count, uint8_t alpha = 255) -> void;
+
+        // rgb = round(rgb * a / 255), alpha kept. source may equal destination.
+        auto premultiply_alpha(const uint8_t* rgba, uint8_t* destination, size_t count) -> void;
+
+        // Writes channel_count bytes per texel, byte k taken from source channel channels[k] (0 to 3). Packs
+        // glTF's metallic (b) and roughness (g) into a two channel image with channels = {2, 1}, or reorders to bgra.
+        auto swizzle(const uint8_t* rgba, uint8_t* destination, size_t count, const uint8_t* channels, uint32_t channel_count) -> void;
+
+        // RGBA8 with sRGB encoded rgb to linear floats, alpha is linear in both
+        auto srgb_to_linear(const uint8_t* rgba, float* linear, size_t count) -> void;
+        // Linear RGBA floats, clamped to [0, 1], to RGBA8 with sRGB encoded rgb
+        auto linear_to_srgb(const float* linear, uint8_t* rgba, size_t count) -> void;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace uka
+{
+    // Stable LSD radix sort of items by their uint64_t key member, one byte per pass.
+    // Passes where every key has the same byte are skipped, so keys that only use a few bits sort in a few passes.
+    template<typename T>
+    auto radix_sort(std::vector<T>& items, std::vector<T>& scratch) -> void
+    {
+        const auto count = items.size();
+        if(count < 2)
+        {
+            return;
+        }
+        size_t histograms[8][256] = {};
+        for(const auto& item : items)
+        {
+            for(auto pass = 0; pass < 8; pass++)
+            {
+                histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+            }
+        }
+        scratch.resize(count);
+        for(auto pass = 0; pass < 8; pass++)
+        {
+            auto& histogram = histograms[pass];
+            if(histogram[(items[0].key >> (pass * 8)) & 0xff] == count)
+            {
+                continue;
+            }
+            auto offset = size_t{0};
+            for(auto& bucket : histogram)
+            {
+                auto bucket_count = bucket;
+                bucket = offset;
+                offset += bucket_count;
+            }
+            for(const auto& item : items)
+            {
+                scratch[histogram[(item.key >> (pass * 8)) & 0xff]++] = item;
+            }
+            std::swap(items, scratch);
+        }
+    }
+}
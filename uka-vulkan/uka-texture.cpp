@@ -3,6 +3,79 @@
 
 namespace uka
 {
+    // Basis Universal transcode target: BC5 for one or two channel data such as normal maps, BC7 for the rest,
+    // BC3 or BC1 by alpha where BC7 is missing and uncompressed RGBA as the last resort
+    static auto select_transcode_format(Uka_Device* device, ktxTexture2* texture, ktx_transcode_fmt_e& transcode_format) -> VkFormat
+    {
+        auto supported = [&](VkFormat format)
+        {
+            auto format_properties = VkFormatProperties{};
+            vkGetPhysicalDeviceFormatProperties(device->physical_device, format, &format_properties);
+            return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+        };
+        const auto srgb = ktxTexture2_GetOETF(texture) == KHR_DF_TRANSFER_SRGB;
+        const auto components = ktxTexture2_GetNumComponents(texture);
+        if(components <= 2 && !srgb && supported(VK_FORMAT_BC5_UNORM_BLOCK))
+        {
+            transcode_format = KTX_TTF_BC5_RG;
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        }
+        const auto bc7 = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        if(supported(bc7))
+        {
+            transcode_format = KTX_TTF_BC7_RGBA;
+            return bc7;
+        }
+        if(components == 4)
+        {
+            const auto bc3 = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            if(supported(bc3))
+            {
+                transcode_format = KTX_TTF_BC3_RGBA;
+                return bc3;
+            }
+        }
+        else
+        {
+            const auto bc1 = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            if(supported(bc1))
+            {
+                transcode_format = KTX_TTF_BC1_RGB;
+                return bc1;
+            }
+        }
+        transcode_format = KTX_TTF_RGBA32;
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    auto load_ktx_file(const std::string& file_path, Uka_Device* device, ktxTexture** ktx_texture, VkFormat& format) -> ktxResult
+    {
+        auto result = ktxTexture_CreateFromNamedFile(file_path.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, ktx_texture);
+        if(result != KTX_SUCCESS || (*ktx_texture)->classId != ktxTexture2_c)
+        {
+            return result;
+        }
+        auto* texture2 = reinterpret_cast<ktxTexture2*>(*ktx_texture);
+        if(ktxTexture2_NeedsTranscoding(texture2))
+        {
+            auto transcode_format = KTX_TTF_RGBA32;
+            const auto transcoded_format = select_transcode_format(device, texture2, transcode_format);
+            result = ktxTexture2_TranscodeBasis(texture2, transcode_format, 0);
+            if(result != KTX_SUCCESS)
+            {
+                ktxTexture_Destroy(*ktx_texture);
+                *ktx_texture = nullptr;
+                return result;
+            }
+            format = transcoded_format;
+        }
+        else if(texture2->vkFormat != VK_FORMAT_UNDEFINED)
+        {
+            format = static_cast<VkFormat>(texture2->vkFormat);
+        }
+        return KTX_SUCCESS;
+    }
+
     auto Uka_Texture::update_descriptor() ->void
     {
         descriptor.sampler = sampler;
@@ -19,15 +92,18 @@ namespace uka
         vkFreeMemory(this->device->logical_device, device_memory, nullptr);
     }
 
-    auto Uka_Texture::load_ktx(std::string file_path, ktxTexture** ktx_texture) ->ktxResult
+    auto Uka_Texture::load_ktx(std::string file_path, ktxTexture** ktx_texture, VkFormat* format) ->ktxResult
     {
-        auto result = KTX_SUCCESS;
         //if(!uka::tools::file_exists(file_path))
         //{
         //    uka::tools::exit_fatal("Could not load texture from " + file_path + " file not found.",-1);
         //}
-        result = ktxTexture_CreateFromNamedFile(file_path.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, ktx_texture);
-
+        auto file_format = format != nullptr ? *format : VK_FORMAT_UNDEFINED;
+        auto result = load_ktx_file(file_path, device, ktx_texture, file_format);
+        if(format != nullptr)
+        {
+            *format = file_format;
+        }
         return result;
     }
 
@@ -39,10 +115,10 @@ namespace uka
                     bool force_linear) -> void
     {
         ktxTexture* ktx_texture;
-        auto result = load_ktx(file_path, &ktx_texture);
+        this->device = device;
+        auto result = load_ktx(file_path, &ktx_texture, &format);
         assert(result == KTX_SUCCESS);
 
-        this->device = device;
         width = ktx_texture->baseWidth;
         height = ktx_texture->baseHeight;
         mip_levels = ktx_texture->numLevels;
@@ -234,10 +310,10 @@ namespace uka
         VkImageLayout img_layout) -> void
     {
         ktxTexture* ktx_texture;
-        auto result = load_ktx(file_path, &ktx_texture);
+        this->device = device;
+        auto result = load_ktx(file_path, &ktx_texture, &format);
         assert(result == KTX_SUCCESS);
 
-        this->device = device;
         width = ktx_texture->baseWidth;
         height = ktx_texture->baseHeight;
         mip_levels = ktx_texture->numLevels;
@@ -372,10 +448,10 @@ namespace uka
         VkImageLayout img_layout) -> void
     {
         ktxTexture* ktx_texture;
-        auto result = load_ktx(file_path, &ktx_texture);
+        this->device = device;
+        auto result = load_ktx(file_path, &ktx_texture, &format);
         assert(result == KTX_SUCCESS);
 
-        this->device = device;
         width = ktx_texture->baseWidth;
         height = ktx_texture->baseHeight;
         mip_levels = ktx_texture->numLevels;
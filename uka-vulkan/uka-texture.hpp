@@ -15,6 +15,11 @@
 
 namespace uka
 {
+    // Opens a KTX or KTX2 file with its image data, libktx inflates zstd supercompressed levels. Basis Universal
+    // payloads are transcoded to the best block compressed format the device samples and format receives it, as it
+    // does the format stored in other KTX2 files. KTX1 files keep the format passed in.
+    auto load_ktx_file(const std::string& file_path, Uka_Device* device, ktxTexture** ktx_texture, VkFormat& format) -> ktxResult;
+
     struct Uka_Texture
     {
         Uka_Device* device;
@@ -30,7 +35,8 @@ namespace uka
 
         auto update_descriptor() -> void;
         auto destroy() -> void;
-        auto load_ktx(std::string file_path,ktxTexture** ktx_texture) ->ktxResult;
+        // Needs device, see load_ktx_file for format
+        auto load_ktx(std::string file_path,ktxTexture** ktx_texture, VkFormat* format = nullptr) ->ktxResult;
     };
 
     struct Uka_Texture2D : Uka_Texture
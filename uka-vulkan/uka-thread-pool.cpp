@@ -0,0 +1,149 @@
+#include "uka-thread-pool.hpp"
+
+namespace uka
+{
+    // Nested parallel_for calls from inside a task run inline instead of deadlocking the pool
+    static thread_local bool inside_pool_task = false;
+
+    Uka_Thread_Pool::Uka_Thread_Pool(uint32_t thread_count)
+    {
+        if(thread_count == 0)
+        {
+            auto hardware_threads = std::thread::hardware_concurrency();
+            thread_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+        }
+        workers.reserve(thread_count);
+        for(auto i = uint32_t{0}; i < thread_count; i++)
+        {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    Uka_Thread_Pool::~Uka_Thread_Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    auto Uka_Thread_Pool::size() const -> uint32_t
+    {
+        return static_cast<uint32_t>(workers.size()) + 1;
+    }
+
+    auto Uka_Thread_Pool::run_job(const std::function<void(uint32_t)>* function, uint32_t count) -> void
+    {
+        if(!function)
+        {
+            return;
+        }
+        inside_pool_task = true;
+        for(;;)
+        {
+            auto index = next_index.fetch_add(1);
+            if(index >= count)
+            {
+                break;
+            }
+            try
+            {
+                (*function)(index);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        inside_pool_task = false;
+    }
+
+    auto Uka_Thread_Pool::worker_loop() -> void
+    {
+        auto seen_generation = uint64_t{0};
+        for(;;)
+        {
+            const std::function<void(uint32_t)>* function = nullptr;
+            auto count = uint32_t{0};
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if(stopping)
+                {
+                    return;
+                }
+                seen_generation = generation;
+                function = job;
+                count = job_count;
+                active_workers++;
+            }
+            run_job(function, count);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active_workers--;
+                if(active_workers == 0)
+                {
+                    done.notify_all();
+                }
+            }
+        }
+    }
+
+    auto Uka_Thread_Pool::parallel_for(uint32_t count, const std::function<void(uint32_t)>& function) -> void
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        if(workers.empty() || count == 1 || inside_pool_task)
+        {
+            for(auto i = uint32_t{0}; i < count; i++)
+            {
+                function(i);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit_lock(submit_mutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &function;
+            job_count = count;
+            next_index = 0;
+            error = nullptr;
+            generation++;
+        }
+        wake.notify_all();
+
+        run_job(&function, count);
+
+        auto job_error = std::exception_ptr{};
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return active_workers == 0; });
+            job = nullptr;
+            job_count = 0;
+            job_error = error;
+            error = nullptr;
+        }
+        if(job_error)
+        {
+            std::rethrow_exception(job_error);
+        }
+    }
+
+    auto Uka_Thread_Pool::global() -> Uka_Thread_Pool&
+    {
+        static Uka_Thread_Pool pool;
+        return pool;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uka
+{
+    struct Uka_Thread_Pool
+    {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::mutex submit_mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(uint32_t)>* job = nullptr;
+        uint32_t job_count = 0;
+        uint32_t active_workers = 0;
+        uint64_t generation = 0;
+        bool stopping = false;
+        std::atomic<uint32_t> next_index{0};
+        std::exception_ptr error;
+
+        auto worker_loop() -> void;
+        auto run_job(const std::function<void(uint32_t)>* function, uint32_t count) -> void;
+    public:
+        // thread_count == 0 picks hardware_concurrency - 1, the calling thread works too
+        explicit Uka_Thread_Pool(uint32_t thread_count = 0);
+        ~Uka_Thread_Pool();
+        Uka_Thread_Pool(const Uka_Thread_Pool&) = delete;
+        auto operator=(const Uka_Thread_Pool&) -> Uka_Thread_Pool& = delete;
+
+        auto size() const -> uint32_t;
+        // Calls function(i) for every i in [0, count) and blocks until all are done.
+        // The first exception thrown by a task is rethrown on the calling thread.
+        auto parallel_for(uint32_t count, const std::function<void(uint32_t)>& function) -> void;
+
+        static auto global() -> Uka_Thread_Pool&;
+    };
+}
@@ -0,0 +1,94 @@
+#include "uka-upload-batch.hpp"
+
+#include <stdexcept>
+
+namespace uka
+{
+    Uka_Upload_Batch::~Uka_Upload_Batch()
+    {
+        destroy();
+        if(fence != VK_NULL_HANDLE)
+        {
+            vkDestroyFence(device->logical_device, fence, nullptr);
+        }
+    }
+
+    auto Uka_Upload_Batch::begin(VkDeviceSize capacity) -> void
+    {
+        destroy();
+        this->capacity = std::max<VkDeviceSize>(capacity, 1);
+        used = 0;
+        VK_CHECK_RESULT(device->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, this->capacity, &staging_buffer, &staging_memory));
+        VK_CHECK_RESULT(vkMapMemory(device->logical_device, staging_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped)));
+        command_buffer = device->create_command_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pool(), true);
+    }
+
+    auto Uka_Upload_Batch::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) -> uint8_t*
+    {
+        offset = (used + alignment - 1) & ~(alignment - 1);
+        if(offset + size > capacity)
+        {
+            throw std::runtime_error("Upload batch staging buffer is full");
+        }
+        used = offset + size;
+        return mapped + offset;
+    }
+
+    auto Uka_Upload_Batch::submit(VkQueue queue) -> void
+    {
+        device->flush_command_buffer(command_buffer, queue, pool());
+        command_buffer = VK_NULL_HANDLE;
+        destroy();
+    }
+
+    auto Uka_Upload_Batch::submit_async(VkQueue queue) -> void
+    {
+        VK_CHECK_RESULT(vkEndCommandBuffer(command_buffer));
+        if(fence == VK_NULL_HANDLE)
+        {
+            auto fence_info = uka::init::fence_create_info();
+            VK_CHECK_RESULT(vkCreateFence(device->logical_device, &fence_info, nullptr, &fence));
+        }
+        auto submit_info = uka::init::submit_info();
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer;
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submit_info, fence));
+        pending = true;
+    }
+
+    auto Uka_Upload_Batch::finished() const -> bool
+    {
+        return !pending || vkGetFenceStatus(device->logical_device, fence) == VK_SUCCESS;
+    }
+
+    auto Uka_Upload_Batch::pool() const -> VkCommandPool
+    {
+        return command_pool != VK_NULL_HANDLE ? command_pool : device->command_pool;
+    }
+
+    auto Uka_Upload_Batch::destroy() -> void
+    {
+        if(pending)
+        {
+            VK_CHECK_RESULT(vkWaitForFences(device->logical_device, 1, &fence, VK_TRUE, UINT64_MAX));
+            VK_CHECK_RESULT(vkResetFences(device->logical_device, 1, &fence));
+            pending = false;
+        }
+        if(command_buffer != VK_NULL_HANDLE)
+        {
+            vkFreeCommandBuffers(device->logical_device, pool(), 1, &command_buffer);
+            command_buffer = VK_NULL_HANDLE;
+        }
+        if(staging_buffer != VK_NULL_HANDLE)
+        {
+            vkUnmapMemory(device->logical_device, staging_memory);
+            vkDestroyBuffer(device->logical_device, staging_buffer, nullptr);
+            vkFreeMemory(device->logical_device, staging_memory, nullptr);
+            staging_buffer = VK_NULL_HANDLE;
+            staging_memory = VK_NULL_HANDLE;
+            mapped = nullptr;
+        }
+        capacity = 0;
+        used = 0;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "uka-device.hpp"
+
+namespace uka
+{
+    // One staging allocation and one command buffer shared by many uploads. Everything recorded between begin and
+    // submit reaches the queue in a single submission with a single fence wait, staging is freed afterwards.
+    struct Uka_Upload_Batch
+    {
+        Uka_Device* device = nullptr;
+        // Host visible and coherent, persistently mapped
+        VkBuffer staging_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+        uint8_t* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize used = 0;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        // Pool of the queue family the batch is submitted to, null uses the device's graphics pool
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        // Signaled when an asynchronous submission completed
+        VkFence fence = VK_NULL_HANDLE;
+
+        explicit Uka_Upload_Batch(Uka_Device* device, VkCommandPool command_pool = VK_NULL_HANDLE) : device(device), command_pool(command_pool) {}
+        ~Uka_Upload_Batch();
+        Uka_Upload_Batch(const Uka_Upload_Batch&) = delete;
+        auto operator=(const Uka_Upload_Batch&) -> Uka_Upload_Batch& = delete;
+
+        // Allocates capacity bytes of staging and starts recording
+        auto begin(VkDeviceSize capacity) -> void;
+        // Returns size bytes of mapped staging at offset into staging_buffer, throws when the batch is full.
+        // alignment must be a power of two.
+        auto allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) -> uint8_t*;
+        // Submits the recorded commands, waits for them and frees the staging memory
+        auto submit(VkQueue queue) -> void;
+        // Submits without waiting. Staging stays allocated until destroy, which waits for the submission.
+        auto submit_async(VkQueue queue) -> void;
+        // True when no asynchronous submission is pending
+        auto finished() const -> bool;
+        // Waits for a pending submission and frees staging and the command buffer, the batch can begin again
+        auto destroy() -> void;
+    private:
+        bool pending = false;
+
+        auto pool() const -> VkCommandPool;
+    };
+}
@@ -207,23 +207,25 @@ namespace uka{
             return descriptor_img_info;
         }
 
-        inline auto write_descriptor_set(VkDescriptorSet set,uint32_t binding,uint32_t array_element,VkDescriptorType type,const VkDescriptorImageInfo* img_info) -> VkWriteDescriptorSet {
+        inline auto write_descriptor_set(VkDescriptorSet set,uint32_t binding,uint32_t array_element,VkDescriptorType type,const VkDescriptorImageInfo* img_info,uint32_t count = 1) -> VkWriteDescriptorSet {
             auto write_descriptor_set = VkWriteDescriptorSet{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
             write_descriptor_set.dstSet = set;
             write_descriptor_set.dstBinding = binding;
             write_descriptor_set.dstArrayElement = array_element;
             write_descriptor_set.descriptorType = type;
             write_descriptor_set.pImageInfo = img_info;
+            write_descriptor_set.descriptorCount = count;
             return write_descriptor_set;
         }
 
-        inline auto write_descriptor_set(VkDescriptorSet set,uint32_t binding,uint32_t array_element,VkDescriptorType type,const VkDescriptorBufferInfo* buffer_info) -> VkWriteDescriptorSet {
+        inline auto write_descriptor_set(VkDescriptorSet set,uint32_t binding,uint32_t array_element,VkDescriptorType type,const VkDescriptorBufferInfo* buffer_info,uint32_t count = 1) -> VkWriteDescriptorSet {
             auto write_descriptor_set = VkWriteDescriptorSet{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
             write_descriptor_set.dstSet = set;
             write_descriptor_set.dstBinding = binding;
             write_descriptor_set.dstArrayElement = array_element;
             write_descriptor_set.descriptorType = type;
             write_descriptor_set.pBufferInfo = buffer_info;
+            write_descriptor_set.descriptorCount = count;
             return write_descriptor_set;
         }
 